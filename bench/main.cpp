@@ -0,0 +1,652 @@
+// Compares gem's hash maps with std::unordered_map. Build with optimizations,
+// e.g. cmake -DCMAKE_BUILD_TYPE=Release, and run
+//
+//   gem_bench [filter] [--size N] [--threads N]
+//
+// where filter selects benchmarks whose name contains it. Every benchmark
+// reports the throughput, the 50th/99th/99.9th percentile of the latency per
+// operation, measured over batches of operations since timing single
+// operations would mostly measure the clock, and where it applies the heap
+// memory held by the container.
+#include <gem/concurrent_hashmap.h>
+#include <gem/flat_hashmap.h>
+#include <gem/hashmap.h>
+#include <gem/node_pool.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// live heap bytes, maintained by the replaced operator new/delete below
+std::atomic<std::size_t> allocated{0};
+
+constexpr std::size_t alloc_header = alignof(std::max_align_t);
+
+} // namespace
+
+void*
+operator new(const std::size_t size)
+{
+    const auto block =
+        static_cast<unsigned char*>(std::malloc(size + alloc_header));
+    if (!block)
+    {
+        throw std::bad_alloc{};
+    }
+    std::memcpy(block, &size, sizeof(size));
+    allocated.fetch_add(size, std::memory_order_relaxed);
+    return block + alloc_header;
+}
+
+void
+operator delete(void* const ptr) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+    const auto block = static_cast<unsigned char*>(ptr) - alloc_header;
+    std::size_t size;
+    std::memcpy(&size, block, sizeof(size));
+    allocated.fetch_sub(size, std::memory_order_relaxed);
+    std::free(block);
+}
+
+void
+operator delete(void* const ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+// Over-aligned allocations (e.g. the slabs of gem::node_pool) keep the size
+// and the start of the block right before the aligned pointer
+void*
+operator new(const std::size_t size, const std::align_val_t alignment)
+{
+    const auto align = static_cast<std::size_t>(alignment);
+    constexpr auto header = sizeof(std::size_t) + sizeof(void*);
+    const auto block =
+        static_cast<unsigned char*>(std::malloc(size + header + align));
+    if (!block)
+    {
+        throw std::bad_alloc{};
+    }
+    const auto address = reinterpret_cast<std::uintptr_t>(block) + header;
+    const auto ptr = reinterpret_cast<unsigned char*>(
+        (address + align - 1) & ~static_cast<std::uintptr_t>(align - 1));
+    std::memcpy(ptr - header, &size, sizeof(size));
+    std::memcpy(ptr - sizeof(void*), &block, sizeof(void*));
+    allocated.fetch_add(size, std::memory_order_relaxed);
+    return ptr;
+}
+
+void
+operator delete(void* const ptr, std::align_val_t) noexcept
+{
+    if (!ptr)
+    {
+        return;
+    }
+    const auto bytes = static_cast<unsigned char*>(ptr);
+    std::size_t size;
+    std::memcpy(&size,
+                bytes - sizeof(std::size_t) - sizeof(void*),
+                sizeof(size));
+    void* block;
+    std::memcpy(&block, bytes - sizeof(void*), sizeof(void*));
+    allocated.fetch_sub(size, std::memory_order_relaxed);
+    std::free(block);
+}
+
+void
+operator delete(void* const ptr,
+                std::size_t,
+                const std::align_val_t alignment) noexcept
+{
+    operator delete(ptr, alignment);
+}
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t batch = 64;
+
+// keeps the compiler from dropping lookups whose result is unused
+std::atomic<std::size_t> sink{0};
+
+struct options
+{
+    std::string filter;
+    std::size_t size = 100000;
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+struct result
+{
+    std::size_t ops = 0;
+    double seconds = 0;
+    std::vector<double> samples; // nanoseconds per operation of each batch
+    std::size_t memory = 0;
+};
+
+// Runs op(i) for i in [0, ops) and samples the latency per batch
+template <typename Op>
+void
+measure(result& r, const std::size_t ops, Op&& op)
+{
+    r.samples.reserve(r.samples.size() + ops / batch);
+    const auto start = clock_type::now();
+    auto batch_start = start;
+    for (std::size_t i = 0; i < ops; ++i)
+    {
+        op(i);
+        if ((i + 1) % batch == 0)
+        {
+            const auto now = clock_type::now();
+            const std::chrono::duration<double, std::nano> elapsed =
+                now - batch_start;
+            r.samples.push_back(elapsed.count() / batch);
+            batch_start = now;
+        }
+    }
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+    r.seconds += elapsed.count();
+    r.ops += ops;
+}
+
+double
+percentile(const std::vector<double>& sorted, const double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    const auto index = static_cast<std::size_t>(
+        p * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+void
+print_header()
+{
+    std::printf("%-24s %-24s %9s %9s %9s %9s %10s\n",
+                "benchmark",
+                "container",
+                "Mops/s",
+                "p50 ns",
+                "p99 ns",
+                "p99.9 ns",
+                "memory KiB");
+}
+
+void
+report(const std::string& benchmark, const std::string& container, result r)
+{
+    std::sort(r.samples.begin(), r.samples.end());
+    const auto mops = static_cast<double>(r.ops) / r.seconds / 1e6;
+    std::printf("%-24s %-24s %9.2f %9.1f %9.1f %9.1f ",
+                benchmark.c_str(),
+                container.c_str(),
+                mops,
+                percentile(r.samples, 0.5),
+                percentile(r.samples, 0.99),
+                percentile(r.samples, 0.999));
+    if (r.memory)
+    {
+        std::printf("%10zu\n", r.memory / 1024);
+    }
+    else
+    {
+        std::printf("%10s\n", "-");
+    }
+    std::fflush(stdout);
+}
+
+// Returns count distinct keys of at least the given length in random order
+std::vector<std::string>
+make_keys(const std::size_t count,
+          const std::size_t length,
+          const std::uint64_t seed)
+{
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto key = std::to_string(seed) + ':' + std::to_string(i);
+        if (key.size() < length)
+        {
+            key.insert(0, length - key.size(), 'k');
+        }
+        keys.push_back(std::move(key));
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64{seed});
+    return keys;
+}
+
+// Adapters give all containers the same interface
+
+template <typename Map>
+struct gem_adapter
+{
+    void
+    reserve(const std::size_t count)
+    {
+        if constexpr (std::is_same_v<Map, gem::hashmap<int>>)
+        {
+            map.reserve(count);
+        }
+    }
+
+    void
+    put(const std::string& key, const int value)
+    {
+        map.put(key, value);
+    }
+
+    bool
+    get(const std::string& key) const
+    {
+        return map.get(key).has_value();
+    }
+
+    bool
+    remove(const std::string& key)
+    {
+        return map.remove(key).has_value();
+    }
+
+    Map map;
+};
+
+using gem_hashmap = gem_adapter<gem::hashmap<int>>;
+using gem_pool_hashmap = gem_adapter<gem::hashmap<int,
+                                                  16,
+                                                  gem::plain_storage,
+                                                  gem::hash,
+                                                  gem::node_pool<int>>>;
+using gem_flat_hashmap = gem_adapter<gem::flat_hashmap<int>>;
+
+struct std_hashmap
+{
+    void
+    reserve(const std::size_t count)
+    {
+        map.reserve(count);
+    }
+
+    void
+    put(const std::string& key, const int value)
+    {
+        map.insert_or_assign(key, value);
+    }
+
+    bool
+    get(const std::string& key) const
+    {
+        return map.find(key) != map.end();
+    }
+
+    bool
+    remove(const std::string& key)
+    {
+        return map.erase(key) > 0;
+    }
+
+    std::unordered_map<std::string, int> map;
+};
+
+template <typename Adapter>
+void
+fill(Adapter& adapter, const std::vector<std::string>& keys)
+{
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        adapter.put(keys[i], static_cast<int>(i));
+    }
+}
+
+template <typename Adapter>
+void
+bench_insert(const std::string& container,
+             const std::vector<std::string>& keys,
+             const std::string& suffix)
+{
+    result r;
+    const auto before = allocated.load();
+    {
+        Adapter adapter;
+        measure(r, keys.size(), [&](const std::size_t i) {
+            adapter.put(keys[i], static_cast<int>(i));
+        });
+        r.memory = allocated.load() - before;
+    }
+    report("insert" + suffix, container, std::move(r));
+}
+
+template <typename Adapter>
+void
+bench_lookup(const std::string& container,
+             const std::vector<std::string>& keys,
+             const std::vector<std::string>& missing,
+             const std::string& suffix)
+{
+    Adapter adapter;
+    fill(adapter, keys);
+    result hit;
+    measure(hit, keys.size(), [&](const std::size_t i) {
+        sink.fetch_add(adapter.get(keys[i]), std::memory_order_relaxed);
+    });
+    report("lookup_hit" + suffix, container, std::move(hit));
+    result miss;
+    measure(miss, missing.size(), [&](const std::size_t i) {
+        sink.fetch_add(adapter.get(missing[i]), std::memory_order_relaxed);
+    });
+    report("lookup_miss" + suffix, container, std::move(miss));
+}
+
+template <typename Adapter>
+void
+bench_erase(const std::string& container,
+            const std::vector<std::string>& keys,
+            const std::string& suffix)
+{
+    Adapter adapter;
+    fill(adapter, keys);
+    result r;
+    measure(r, keys.size(), [&](const std::size_t i) {
+        sink.fetch_add(adapter.remove(keys[i]), std::memory_order_relaxed);
+    });
+    report("erase" + suffix, container, std::move(r));
+}
+
+// 90% lookups, 5% inserts and 5% erases on a filled map
+template <typename Adapter>
+void
+bench_mixed(const std::string& container,
+            const std::vector<std::string>& keys,
+            const std::vector<unsigned char>& choices,
+            const std::string& suffix)
+{
+    Adapter adapter;
+    fill(adapter, keys);
+    result r;
+    measure(r, choices.size(), [&](const std::size_t i) {
+        const auto& key = keys[(i * 7919) % keys.size()];
+        if (choices[i] < 90)
+        {
+            sink.fetch_add(adapter.get(key), std::memory_order_relaxed);
+        }
+        else if (choices[i] < 95)
+        {
+            adapter.put(key, static_cast<int>(i));
+        }
+        else
+        {
+            adapter.remove(key);
+        }
+    });
+    report("mixed" + suffix, container, std::move(r));
+}
+
+// Lookups in a map holding load_factor * buckets entries. Only containers
+// whose bucket count can be set up front take part
+template <typename Adapter>
+void
+bench_load_factor(const std::string& container,
+                  const std::vector<std::string>& keys,
+                  const std::size_t buckets,
+                  const double load_factor)
+{
+    // at least one entry to look up, even for tiny sizes
+    const auto count = std::max<std::size_t>(
+        1, static_cast<std::size_t>(load_factor * static_cast<double>(buckets)));
+    Adapter adapter;
+    adapter.reserve(buckets);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        adapter.put(keys[i], static_cast<int>(i));
+    }
+    result r;
+    measure(r, keys.size(), [&](const std::size_t i) {
+        sink.fetch_add(adapter.get(keys[i % count]),
+                       std::memory_order_relaxed);
+    });
+    char name[32];
+    std::snprintf(name, sizeof(name), "lookup_hit/lf=%.2f", load_factor);
+    report(name, container, std::move(r));
+}
+
+// Runs the mixed workload on a map shared by the given number of threads and
+// merges the samples of all threads
+template <typename Map>
+void
+bench_threads(const std::string& container,
+              const std::vector<std::string>& keys,
+              const std::vector<unsigned char>& choices,
+              const std::size_t threads)
+{
+    Map map;
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        map.put(keys[i], static_cast<int>(i));
+    }
+    std::vector<result> results(threads);
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> ready{0};
+    std::atomic<bool> go{false};
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            ready++;
+            while (!go.load())
+            {
+            }
+            // counted per thread so that the threads only share the map
+            std::size_t found = 0;
+            measure(results[t], choices.size(), [&](const std::size_t i) {
+                const auto& key = keys[(i * 7919 + t * 104729) % keys.size()];
+                if (choices[i] < 90)
+                {
+                    found += map.get(key).has_value();
+                }
+                else if (choices[i] < 95)
+                {
+                    map.put(key, static_cast<int>(i));
+                }
+                else
+                {
+                    map.remove(key);
+                }
+            });
+            sink.fetch_add(found, std::memory_order_relaxed);
+        });
+    }
+    while (ready.load() < threads)
+    {
+    }
+    const auto start = clock_type::now();
+    go = true;
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+    result merged;
+    merged.seconds = elapsed.count();
+    for (auto& r : results)
+    {
+        merged.ops += r.ops;
+        merged.samples.insert(
+            merged.samples.end(), r.samples.begin(), r.samples.end());
+    }
+    report("mixed/threads=" + std::to_string(threads),
+           container,
+           std::move(merged));
+}
+
+// A std::unordered_map behind a single reader-writer lock, the baseline for
+// gem::concurrent_hashmap
+class locked_std_hashmap
+{
+public:
+    void
+    put(const std::string& key, const int value)
+    {
+        std::lock_guard lock{mutex_};
+        map_.insert_or_assign(key, value);
+    }
+
+    std::optional<int>
+    get(const std::string& key) const
+    {
+        std::shared_lock lock{mutex_};
+        const auto it = map_.find(key);
+        return it != map_.end() ? std::optional<int>{it->second}
+                                : std::nullopt;
+    }
+
+    std::optional<int>
+    remove(const std::string& key)
+    {
+        std::lock_guard lock{mutex_};
+        const auto it = map_.find(key);
+        if (it == map_.end())
+        {
+            return {};
+        }
+        const auto value = it->second;
+        map_.erase(it);
+        return value;
+    }
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, int> map_;
+};
+
+bool
+selected(const options& opts, const std::string& name)
+{
+    return name.find(opts.filter) != std::string::npos;
+}
+
+options
+parse(const int argc, char** const argv)
+{
+    options opts;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if ((arg == "--size" || arg == "--threads") && i + 1 < argc)
+        {
+            const auto value =
+                static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10));
+            (arg == "--size" ? opts.size : opts.threads) =
+                std::max<std::size_t>(value, 1);
+        }
+        else
+        {
+            opts.filter = arg;
+        }
+    }
+    return opts;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    const auto opts = parse(argc, argv);
+    std::vector<unsigned char> choices(opts.size);
+    {
+        std::mt19937_64 rng{42};
+        std::uniform_int_distribution<int> percent{0, 99};
+        for (auto& c : choices)
+        {
+            c = static_cast<unsigned char>(percent(rng));
+        }
+    }
+    print_header();
+
+    for (const std::size_t length : {8, 32, 128})
+    {
+        const auto keys = make_keys(opts.size, length, 1);
+        const auto missing = make_keys(opts.size, length, 2);
+        const auto suffix = "/key=" + std::to_string(length);
+        if (selected(opts, "insert" + suffix))
+        {
+            bench_insert<gem_hashmap>("gem::hashmap", keys, suffix);
+            bench_insert<gem_pool_hashmap>("gem::hashmap+pool", keys, suffix);
+            bench_insert<gem_flat_hashmap>("gem::flat_hashmap", keys, suffix);
+            bench_insert<std_hashmap>("std::unordered_map", keys, suffix);
+        }
+        if (selected(opts, "lookup" + suffix))
+        {
+            bench_lookup<gem_hashmap>("gem::hashmap", keys, missing, suffix);
+            bench_lookup<gem_flat_hashmap>(
+                "gem::flat_hashmap", keys, missing, suffix);
+            bench_lookup<std_hashmap>(
+                "std::unordered_map", keys, missing, suffix);
+        }
+        if (selected(opts, "erase" + suffix))
+        {
+            bench_erase<gem_hashmap>("gem::hashmap", keys, suffix);
+            bench_erase<gem_flat_hashmap>("gem::flat_hashmap", keys, suffix);
+            bench_erase<std_hashmap>("std::unordered_map", keys, suffix);
+        }
+        if (selected(opts, "mixed" + suffix))
+        {
+            bench_mixed<gem_hashmap>("gem::hashmap", keys, choices, suffix);
+            bench_mixed<gem_flat_hashmap>(
+                "gem::flat_hashmap", keys, choices, suffix);
+            bench_mixed<std_hashmap>(
+                "std::unordered_map", keys, choices, suffix);
+        }
+    }
+
+    if (selected(opts, "lookup_hit/lf="))
+    {
+        const auto buckets = gem::detail::next_power_of_2(opts.size);
+        const auto keys = make_keys(buckets, 16, 3);
+        for (const auto load_factor : {0.25, 0.5, 0.9})
+        {
+            bench_load_factor<gem_hashmap>(
+                "gem::hashmap", keys, buckets, load_factor);
+            bench_load_factor<std_hashmap>(
+                "std::unordered_map", keys, buckets, load_factor);
+        }
+    }
+
+    const auto keys = make_keys(opts.size, 16, 4);
+    for (std::size_t threads = 1; threads <= opts.threads; threads *= 2)
+    {
+        if (selected(opts, "mixed/threads=" + std::to_string(threads)))
+        {
+            bench_threads<gem::concurrent_hashmap<int>>(
+                "gem::concurrent_hashmap", keys, choices, threads);
+            bench_threads<locked_std_hashmap>(
+                "std::unordered_map+lock", keys, choices, threads);
+        }
+    }
+    return 0;
+}
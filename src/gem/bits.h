@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace gem
+{
+namespace detail
+{
+
+// Returns the index of the lowest set bit of a mask of at most 64 bits. The
+// mask must not be zero
+template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+std::size_t
+lowest_bit(const T mask) noexcept
+{
+    static_assert(sizeof(T) <= sizeof(std::uint64_t), "mask too wide");
+    if constexpr (sizeof(T) <= sizeof(std::uint32_t))
+    {
+        const auto value = static_cast<std::uint32_t>(mask);
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<std::size_t>(__builtin_ctz(value));
+#elif defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return index;
+#else
+        std::size_t index = 0;
+        while (!((value >> index) & 1u))
+        {
+            ++index;
+        }
+        return index;
+#endif
+    }
+    else
+    {
+        const auto value = static_cast<std::uint64_t>(mask);
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<std::size_t>(__builtin_ctzll(value));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return index;
+#else
+        const auto low = static_cast<std::uint32_t>(value);
+        return low ? lowest_bit(low)
+                   : 32 + lowest_bit(static_cast<std::uint32_t>(value >> 32));
+#endif
+    }
+}
+
+} // namespace detail
+} // namespace gem
@@ -0,0 +1,515 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gem
+{
+namespace detail
+{
+
+// A node of a btree_map. Leaves hold sorted keys with their values and are
+// linked in key order. Inner nodes hold n children and n - 1 separator keys
+// where child i holds the keys below separator i.
+template <typename ValueType>
+struct btree_node
+{
+    bool leaf = true;
+    std::vector<std::string> keys;
+    std::vector<std::optional<ValueType>> values;
+    std::vector<std::unique_ptr<btree_node>> children;
+    btree_node* next = nullptr;
+
+    std::size_t
+    size() const
+    {
+        return leaf ? keys.size() : children.size();
+    }
+};
+
+// A forward iterator over the entries of a btree_map in key order.
+// Dereferencing yields a pair of references to the key and the value
+template <typename ValueType>
+class btree_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<const std::string&, const ValueType&>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    btree_iterator() = default;
+
+    btree_iterator(const btree_node<ValueType>* leaf, const std::size_t index)
+        : leaf_{leaf}
+        , index_{index}
+    {
+        if (leaf_ && index_ == leaf_->keys.size())
+        {
+            next_leaf();
+        }
+    }
+
+    reference
+    operator*() const
+    {
+        return {leaf_->keys[index_], *leaf_->values[index_]};
+    }
+
+    btree_iterator&
+    operator++()
+    {
+        if (++index_ == leaf_->keys.size())
+        {
+            next_leaf();
+        }
+        return *this;
+    }
+
+    btree_iterator
+    operator++(int)
+    {
+        auto copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    bool
+    operator==(const btree_iterator& other) const
+    {
+        return leaf_ == other.leaf_ && index_ == other.index_;
+    }
+
+    bool
+    operator!=(const btree_iterator& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    // only the root leaf of an empty map has no keys
+    void
+    next_leaf()
+    {
+        leaf_ = leaf_->next;
+        index_ = 0;
+    }
+
+    const btree_node<ValueType>* leaf_ = nullptr;
+    std::size_t index_ = 0;
+};
+
+} // namespace detail
+
+// A pair of iterators usable in a range-based for loop
+template <typename Iterator>
+struct iterator_range
+{
+    Iterator first;
+    Iterator last;
+
+    Iterator
+    begin() const
+    {
+        return first;
+    }
+
+    Iterator
+    end() const
+    {
+        return last;
+    }
+};
+
+// An ordered map with string keys implemented as a B+-tree. Every node
+// holds up to NodeSize keys or children in contiguous arrays, so a lookup
+// touches few cache lines per level, and the leaves are linked so that range
+// and prefix scans walk the entries in key order without revisiting inner
+// nodes. Nodes that fall below half of NodeSize after a remove borrow from
+// or are merged with a sibling. Keys are ordered bytewise like std::string.
+template <typename ValueType, std::size_t NodeSize = 32>
+class btree_map
+{
+public:
+    static_assert(NodeSize >= 4, "NodeSize must be at least 4");
+
+    using value_type = ValueType;
+    using const_iterator = gem::detail::btree_iterator<ValueType>;
+    using range_type = gem::iterator_range<const_iterator>;
+
+    btree_map()
+        : root_{std::make_unique<node_type>()}
+    {
+    }
+
+    // delete copy semantics
+    btree_map(const btree_map&) = delete;
+    btree_map& operator=(const btree_map&) = delete;
+
+    // The moved-from map gets a new empty root
+    btree_map(btree_map&& other)
+        : root_{std::exchange(other.root_, std::make_unique<node_type>())}
+        , size_{std::exchange(other.size_, 0)}
+    {
+    }
+
+    btree_map&
+    operator=(btree_map&& other)
+    {
+        if (this != &other)
+        {
+            auto root = std::make_unique<node_type>();
+            root_ = std::exchange(other.root_, std::move(root));
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+
+    // Inserts or replaces the value of the given key. A std::string key is
+    // only constructed if the key does not exist yet
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        std::optional<value_type> old_value;
+        auto split = insert(
+            *root_, std::forward<K>(key), std::forward<T>(value), old_value);
+        if (split)
+        {
+            auto root = std::make_unique<node_type>();
+            root->leaf = false;
+            root->keys.push_back(std::move(split->first));
+            root->children.push_back(std::move(root_));
+            root->children.push_back(std::move(split->second));
+            root_ = std::move(root);
+        }
+        if (!old_value)
+        {
+            size_++;
+        }
+        return old_value;
+    }
+
+    const std::optional<value_type>&
+    get(const std::string_view key) const
+    {
+        const auto leaf = find_leaf(key);
+        const auto i = position(*leaf, key);
+        if (i < leaf->keys.size() && leaf->keys[i] == key)
+        {
+            return leaf->values[i];
+        }
+        return empty_;
+    }
+
+    std::optional<value_type>
+    remove(const std::string_view key)
+    {
+        auto old_value = erase(*root_, key);
+        if (old_value)
+        {
+            size_--;
+            if (!root_->leaf && root_->children.size() == 1)
+            {
+                auto child = std::move(root_->children.front());
+                root_ = std::move(child);
+            }
+        }
+        return old_value;
+    }
+
+    const_iterator
+    begin() const
+    {
+        auto node = root_.get();
+        while (!node->leaf)
+        {
+            node = node->children.front().get();
+        }
+        return const_iterator{node, 0};
+    }
+
+    const_iterator
+    end() const
+    {
+        return {};
+    }
+
+    // Returns an iterator to the first entry whose key is not less than the
+    // given key
+    const_iterator
+    lower_bound(const std::string_view key) const
+    {
+        const auto leaf = find_leaf(key);
+        return const_iterator{leaf, position(*leaf, key)};
+    }
+
+    // Returns the entries with keys in [first, last)
+    range_type
+    range(const std::string_view first, const std::string_view last) const
+    {
+        if (!(first < last))
+        {
+            return {end(), end()};
+        }
+        return {lower_bound(first), lower_bound(last)};
+    }
+
+    // Returns the entries whose keys start with the given prefix
+    range_type
+    prefix_scan(const std::string_view prefix) const
+    {
+        // the smallest key greater than all keys with the prefix is the
+        // prefix without trailing 0xFF bytes and its last byte incremented
+        auto last = std::string(prefix);
+        while (!last.empty() && static_cast<unsigned char>(last.back()) == 0xFF)
+        {
+            last.pop_back();
+        }
+        if (last.empty())
+        {
+            return {lower_bound(prefix), end()};
+        }
+        last.back() = static_cast<char>(
+            static_cast<unsigned char>(last.back()) + 1);
+        return {lower_bound(prefix), lower_bound(last)};
+    }
+
+private:
+    using node_type = gem::detail::btree_node<value_type>;
+    using split_type = std::optional<
+        std::pair<std::string, std::unique_ptr<node_type>>>;
+
+    static constexpr std::size_t min_size = NodeSize / 2;
+
+    // Returns the index of the first key of the leaf not less than the key
+    static std::size_t
+    position(const node_type& leaf, const std::string_view key)
+    {
+        return static_cast<std::size_t>(
+            std::lower_bound(leaf.keys.begin(), leaf.keys.end(), key) -
+            leaf.keys.begin());
+    }
+
+    static std::size_t
+    child_index(const node_type& node, const std::string_view key)
+    {
+        return static_cast<std::size_t>(
+            std::upper_bound(node.keys.begin(), node.keys.end(), key) -
+            node.keys.begin());
+    }
+
+    const node_type*
+    find_leaf(const std::string_view key) const
+    {
+        const node_type* node = root_.get();
+        while (!node->leaf)
+        {
+            node = node->children[child_index(*node, key)].get();
+        }
+        return node;
+    }
+
+    // Inserts into the subtree of the node and returns the separator and the
+    // new right sibling if the node had to be split
+    template <typename K, typename T>
+    static split_type
+    insert(node_type& node,
+           K&& key,
+           T&& value,
+           std::optional<value_type>& old_value)
+    {
+        if (node.leaf)
+        {
+            const auto it = std::lower_bound(
+                node.keys.begin(), node.keys.end(), std::string_view{key});
+            const auto i = it - node.keys.begin();
+            if (it != node.keys.end() && *it == std::string_view{key})
+            {
+                auto& current = node.values[static_cast<std::size_t>(i)];
+                old_value = std::move(current);
+                current = std::forward<T>(value);
+                return {};
+            }
+            node.keys.insert(it, std::string(std::forward<K>(key)));
+            node.values.insert(node.values.begin() + i, std::forward<T>(value));
+            return node.keys.size() > NodeSize ? split(node) : split_type{};
+        }
+        const auto i = child_index(node, key);
+        auto child_split = insert(*node.children[i],
+                                  std::forward<K>(key),
+                                  std::forward<T>(value),
+                                  old_value);
+        if (!child_split)
+        {
+            return {};
+        }
+        const auto pos = static_cast<std::ptrdiff_t>(i);
+        node.keys.insert(node.keys.begin() + pos,
+                         std::move(child_split->first));
+        node.children.insert(node.children.begin() + pos + 1,
+                             std::move(child_split->second));
+        return node.children.size() > NodeSize ? split(node) : split_type{};
+    }
+
+    // Moves the upper half of the node into a new right sibling
+    static split_type
+    split(node_type& node)
+    {
+        auto right = std::make_unique<node_type>();
+        right->leaf = node.leaf;
+        const auto mid = static_cast<std::ptrdiff_t>(node.keys.size() / 2);
+        std::string separator;
+        if (node.leaf)
+        {
+            move_back(node.keys, mid, right->keys);
+            move_back(node.values, mid, right->values);
+            separator = right->keys.front();
+            right->next = node.next;
+            node.next = right.get();
+        }
+        else
+        {
+            // the middle key moves up into the parent
+            separator = std::move(node.keys[static_cast<std::size_t>(mid)]);
+            move_back(node.keys, mid + 1, right->keys);
+            node.keys.pop_back();
+            move_back(node.children, mid + 1, right->children);
+        }
+        return std::make_pair(std::move(separator), std::move(right));
+    }
+
+    // Moves the elements from the given position on to the end of target
+    template <typename T>
+    static void
+    move_back(std::vector<T>& source,
+              const std::ptrdiff_t first,
+              std::vector<T>& target)
+    {
+        target.insert(target.end(),
+                      std::make_move_iterator(source.begin() + first),
+                      std::make_move_iterator(source.end()));
+        source.erase(source.begin() + first, source.end());
+    }
+
+    // Removes the key from the subtree of the node and rebalances children
+    // which fell below half of NodeSize
+    static std::optional<value_type>
+    erase(node_type& node, const std::string_view key)
+    {
+        if (node.leaf)
+        {
+            const auto i = position(node, key);
+            if (i == node.keys.size() || node.keys[i] != key)
+            {
+                return {};
+            }
+            auto old_value = std::move(node.values[i]);
+            const auto pos = static_cast<std::ptrdiff_t>(i);
+            node.keys.erase(node.keys.begin() + pos);
+            node.values.erase(node.values.begin() + pos);
+            return old_value;
+        }
+        const auto i = child_index(node, key);
+        auto old_value = erase(*node.children[i], key);
+        if (old_value && node.children[i]->size() < min_size)
+        {
+            rebalance(node, i);
+        }
+        return old_value;
+    }
+
+    // Merges the underfull child i with a sibling or, if both do not fit
+    // into one node, moves one entry over from the sibling
+    static void
+    rebalance(node_type& parent, const std::size_t i)
+    {
+        const auto j = i > 0 ? i - 1 : i;
+        auto& left = *parent.children[j];
+        auto& right = *parent.children[j + 1];
+        auto& separator = parent.keys[j];
+        if (left.size() + right.size() <= NodeSize)
+        {
+            if (left.leaf)
+            {
+                move_back(right.keys, 0, left.keys);
+                move_back(right.values, 0, left.values);
+                left.next = right.next;
+            }
+            else
+            {
+                left.keys.push_back(std::move(separator));
+                move_back(right.keys, 0, left.keys);
+                move_back(right.children, 0, left.children);
+            }
+            const auto pos = static_cast<std::ptrdiff_t>(j);
+            parent.keys.erase(parent.keys.begin() + pos);
+            parent.children.erase(parent.children.begin() + pos + 1);
+        }
+        else if (left.size() < right.size())
+        {
+            if (left.leaf)
+            {
+                left.keys.push_back(std::move(right.keys.front()));
+                left.values.push_back(std::move(right.values.front()));
+                right.keys.erase(right.keys.begin());
+                right.values.erase(right.values.begin());
+                separator = right.keys.front();
+            }
+            else
+            {
+                left.keys.push_back(std::move(separator));
+                left.children.push_back(std::move(right.children.front()));
+                separator = std::move(right.keys.front());
+                right.keys.erase(right.keys.begin());
+                right.children.erase(right.children.begin());
+            }
+        }
+        else
+        {
+            if (left.leaf)
+            {
+                right.keys.insert(right.keys.begin(),
+                                  std::move(left.keys.back()));
+                right.values.insert(right.values.begin(),
+                                    std::move(left.values.back()));
+                left.keys.pop_back();
+                left.values.pop_back();
+                separator = right.keys.front();
+            }
+            else
+            {
+                right.keys.insert(right.keys.begin(), std::move(separator));
+                right.children.insert(right.children.begin(),
+                                      std::move(left.children.back()));
+                separator = std::move(left.keys.back());
+                left.keys.pop_back();
+                left.children.pop_back();
+            }
+        }
+    }
+
+    std::unique_ptr<node_type> root_;
+    std::optional<value_type> empty_;
+    std::size_t size_ = 0;
+};
+
+} // namespace gem
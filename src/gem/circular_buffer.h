@@ -1,42 +1,274 @@
 #pragma once
+#include <algorithm>
 #include <cstddef>
+#include <memory>
+#include <new>
 #include <type_traits>
 #include <utility>
 
 namespace gem
 {
+namespace detail
+{
+
+constexpr bool
+is_power_of_2(const std::size_t value) noexcept
+{
+    return value && !(value & (value - 1));
+}
+
+// The positions of the values of a circular_buffer: wrapping indices and a
+// separate size
+template <std::size_t Capacity, bool = is_power_of_2(Capacity)>
+class circular_indices
+{
+public:
+    // Returns the slot of the i-th value from the front
+    std::size_t
+    at(const std::size_t i) const noexcept
+    {
+        return wrap(front_ + i);
+    }
+
+    std::size_t
+    front() const noexcept
+    {
+        return front_;
+    }
+
+    // Returns the slot the next value is pushed to
+    std::size_t
+    end() const noexcept
+    {
+        return end_;
+    }
+
+    std::size_t
+    size() const noexcept
+    {
+        return size_;
+    }
+
+    // Moves the end past a pushed value, dropping the front if full
+    void
+    push() noexcept
+    {
+        increment_or_wrap(end_);
+        if (size_ == Capacity)
+        {
+            increment_or_wrap(front_);
+        }
+        else
+        {
+            ++size_;
+        }
+    }
+
+    void
+    pop() noexcept
+    {
+        increment_or_wrap(front_);
+        --size_;
+    }
+
+    // Moves the end before the last value
+    void
+    pop_back() noexcept
+    {
+        end_ = end_ == 0 ? Capacity - 1 : end_ - 1;
+        --size_;
+    }
+
+    // Moves the end past count pushed values which must fit
+    void
+    push_n(const std::size_t count) noexcept
+    {
+        end_ = wrap(end_ + count);
+        size_ += count;
+    }
+
+    void
+    pop_n(const std::size_t count) noexcept
+    {
+        front_ = wrap(front_ + count);
+        size_ -= count;
+    }
+
+private:
+    static std::size_t
+    wrap(const std::size_t value) noexcept
+    {
+        return value < Capacity ? value : value - Capacity;
+    }
+
+    static void
+    increment_or_wrap(std::size_t& value) noexcept
+    {
+        if (value == Capacity - 1)
+        {
+            value = 0;
+        }
+        else
+        {
+            ++value;
+        }
+    }
+
+    std::size_t end_{};
+    std::size_t front_{};
+    std::size_t size_{};
+};
+
+// For a power of 2 capacity the indices run freely and are masked into
+// slots, so advancing never branches and the size is their difference
+template <std::size_t Capacity>
+class circular_indices<Capacity, true>
+{
+public:
+    std::size_t
+    at(const std::size_t i) const noexcept
+    {
+        return (front_ + i) & mask;
+    }
+
+    std::size_t
+    front() const noexcept
+    {
+        return front_ & mask;
+    }
+
+    std::size_t
+    end() const noexcept
+    {
+        return end_ & mask;
+    }
+
+    std::size_t
+    size() const noexcept
+    {
+        return end_ - front_;
+    }
+
+    void
+    push() noexcept
+    {
+        front_ += size() == Capacity;
+        ++end_;
+    }
+
+    void
+    pop() noexcept
+    {
+        ++front_;
+    }
+
+    void
+    pop_back() noexcept
+    {
+        --end_;
+    }
+
+    void
+    push_n(const std::size_t count) noexcept
+    {
+        end_ += count;
+    }
+
+    void
+    pop_n(const std::size_t count) noexcept
+    {
+        front_ += count;
+    }
+
+private:
+    static constexpr std::size_t mask = Capacity - 1;
+
+    std::size_t end_{};
+    std::size_t front_{};
+};
+
+} // namespace detail
 
 // A simple circular buffer (FIFO) with a capacity fixed at compile time.
-// ValueType must support default construction. The buffer lets you push
-// new values onto the back and pop old values off the front.
+// The buffer lets you push new values onto the back and pop old values off
+// the front. Its storage is left uninitialized, so only populated values are
+// ever constructed and creating a buffer costs nothing.
 template <typename ValueType, std::size_t Capacity>
 class circular_buffer
 {
 public:
-    static_assert(std::is_default_constructible_v<ValueType>,
-                  "ValueType must be default constructible");
     static_assert(Capacity >= 1, "Capacity must be at least 1");
+    static_assert(std::is_nothrow_destructible_v<ValueType>,
+                  "ValueType must be nothrow destructible");
 
     using container_type = circular_buffer;
     using value_type = ValueType;
     using size_type = std::size_t;
     using reference = value_type&;
     using const_reference = const value_type&;
+    using pointer = value_type*;
+    using const_pointer = const value_type*;
+    // A contiguous run of values given by its first value and length
+    using array_range = std::pair<pointer, size_type>;
+    using const_array_range = std::pair<const_pointer, size_type>;
+
+    circular_buffer() noexcept
+    {
+    }
+
+    ~circular_buffer()
+    {
+        clear();
+    }
+
+    circular_buffer(const circular_buffer& other) noexcept(
+        std::is_nothrow_copy_constructible_v<value_type>)
+    {
+        for (size_type i = 0; i < other.size(); ++i)
+        {
+            emplace_back(other.at(i));
+        }
+    }
 
-    circular_buffer() noexcept(std::is_nothrow_constructible_v<value_type>) =
-        default;
-    ~circular_buffer() noexcept(std::is_nothrow_destructible_v<value_type>) =
-        default;
-
-    // Default copy/move semantics
-    circular_buffer(const circular_buffer&) noexcept(
-        std::is_nothrow_copy_constructible_v<value_type>) = default;
-    circular_buffer& operator=(const circular_buffer&) noexcept(
-        std::is_nothrow_copy_assignable_v<value_type>) = default;
-    circular_buffer(circular_buffer&&) noexcept(
-        std::is_nothrow_move_constructible_v<value_type>) = default;
-    circular_buffer& operator=(circular_buffer&&) noexcept(
-        std::is_nothrow_move_assignable_v<value_type>) = default;
+    circular_buffer&
+    operator=(const circular_buffer& other) noexcept(
+        std::is_nothrow_copy_constructible_v<value_type>)
+    {
+        if (this != &other)
+        {
+            clear();
+            for (size_type i = 0; i < other.size(); ++i)
+            {
+                emplace_back(other.at(i));
+            }
+        }
+        return *this;
+    }
+
+    // Moves the values of the given buffer, leaving moved-from values in it
+    circular_buffer(circular_buffer&& other) noexcept(
+        std::is_nothrow_move_constructible_v<value_type>)
+    {
+        for (size_type i = 0; i < other.size(); ++i)
+        {
+            emplace_back(std::move(other.at(i)));
+        }
+    }
+
+    circular_buffer&
+    operator=(circular_buffer&& other) noexcept(
+        std::is_nothrow_move_constructible_v<value_type>)
+    {
+        if (this != &other)
+        {
+            clear();
+            for (size_type i = 0; i < other.size(); ++i)
+            {
+                emplace_back(std::move(other.at(i)));
+            }
+        }
+        return *this;
+    }
 
     // Equals operator
     bool
@@ -46,20 +278,16 @@ public:
     {
         if (this != &other)
         {
-            if (size_ != other.size_)
+            if (size() != other.size())
             {
                 return false;
             }
-            auto front = front_;
-            auto size = size_;
-            while (size != 0)
+            for (size_type i = 0; i < size(); ++i)
             {
-                if (!(data_[front] == other.data_[front]))
+                if (!(at(i) == other.at(i)))
                 {
                     return false;
                 }
-                increment_or_wrap(front);
-                --size;
             }
             return true;
         }
@@ -84,8 +312,138 @@ public:
     void
     push(T&& value)
     {
-        data_[end_] = std::forward<T>(value);
-        increment();
+        emplace_back(std::forward<T>(value));
+    }
+
+    // Constructs a new value in place at the end of the buffer and returns
+    // it. If that exceeds the capacity of the buffer then the oldest value
+    // gets dropped (the one at the front). For a move constructible
+    // value_type the arguments may refer to the oldest value and a throwing
+    // constructor leaves the buffer unchanged. Otherwise the oldest value is
+    // dropped before the new one is constructed in its slot
+    template <typename... Args>
+    reference
+    emplace_back(Args&&... args)
+    {
+        if (full())
+        {
+            if constexpr (std::is_move_constructible_v<value_type>)
+            {
+                // the new value takes the slot of the oldest one which the
+                // arguments may refer to
+                value_type value(std::forward<Args>(args)...);
+                pop();
+                return construct(std::move(value));
+            }
+            else
+            {
+                pop();
+            }
+        }
+        return construct(std::forward<Args>(args)...);
+    }
+
+    // Pushes the values of a random access range onto the end of the buffer
+    // in at most two contiguous chunks (a memcpy for trivially copyable
+    // values). Values exceeding the capacity drop the oldest ones, so at
+    // most the last Capacity values of the range remain. Pass
+    // std::move_iterators to move the values. The range must not refer to
+    // this buffer
+    template <typename RandomIt>
+    void
+    push_range(RandomIt first, const RandomIt last)
+    {
+        auto count = static_cast<size_type>(last - first);
+        if (count > Capacity)
+        {
+            first += static_cast<std::ptrdiff_t>(count - Capacity);
+            count = Capacity;
+        }
+        if (count > Capacity - size())
+        {
+            pop_range(count - (Capacity - size()));
+        }
+        const auto end = indices_.end();
+        const auto first_chunk = std::min(count, Capacity - end);
+        const auto middle = first + static_cast<std::ptrdiff_t>(first_chunk);
+        std::uninitialized_copy(first, middle, storage(end));
+        indices_.push_n(first_chunk);
+        const auto second_chunk = count - first_chunk;
+        std::uninitialized_copy(middle,
+                                middle +
+                                    static_cast<std::ptrdiff_t>(second_chunk),
+                                storage(0));
+        indices_.push_n(second_chunk);
+    }
+
+    // Moves up to count values off the front of the buffer to out in at most
+    // two contiguous chunks and returns the number of values popped
+    template <typename OutputIt>
+    size_type
+    pop_range(OutputIt out, size_type count)
+    {
+        count = std::min(count, size());
+        const auto popped = count;
+        while (count)
+        {
+            const auto front = slot(indices_.front());
+            const auto chunk = std::min(count, Capacity - indices_.front());
+            out = std::move(front, front + chunk, out);
+            std::destroy(front, front + chunk);
+            indices_.pop_n(chunk);
+            count -= chunk;
+        }
+        return popped;
+    }
+
+    // Removes up to count values off the front of the buffer and returns the
+    // number of values removed
+    size_type
+    pop_range(size_type count) noexcept
+    {
+        count = std::min(count, size());
+        const auto popped = count;
+        while (count)
+        {
+            const auto front = slot(indices_.front());
+            const auto chunk = std::min(count, Capacity - indices_.front());
+            std::destroy(front, front + chunk);
+            indices_.pop_n(chunk);
+            count -= chunk;
+        }
+        return popped;
+    }
+
+    // Returns the first contiguous run of values starting at the front. It
+    // holds all values unless they wrap around the end of the storage
+    array_range
+    array_one() noexcept
+    {
+        const auto size = first_run();
+        return {size ? slot(indices_.front()) : nullptr, size};
+    }
+
+    const_array_range
+    array_one() const noexcept
+    {
+        const auto size = first_run();
+        return {size ? slot(indices_.front()) : nullptr, size};
+    }
+
+    // Returns the contiguous run of values following array_one() at the
+    // start of the storage, which is empty unless the values wrap around
+    array_range
+    array_two() noexcept
+    {
+        const auto size = this->size() - first_run();
+        return {size ? slot(0) : nullptr, size};
+    }
+
+    const_array_range
+    array_two() const noexcept
+    {
+        const auto size = this->size() - first_run();
+        return {size ? slot(0) : nullptr, size};
     }
 
     // Returns the value at the front of the buffer (the oldest value).
@@ -93,7 +451,7 @@ public:
     reference
     front() noexcept
     {
-        return data_[front_];
+        return *slot(indices_.front());
     }
 
     // Returns the value at the front of the buffer (the oldest value).
@@ -101,18 +459,34 @@ public:
     const_reference
     front() const noexcept
     {
-        return data_[front_];
+        return *slot(indices_.front());
     }
 
     // Removes the value at the front of the buffer (the oldest value)
     void
-    pop() noexcept(std::is_nothrow_constructible_v<value_type>&&
-                       std::is_nothrow_destructible_v<value_type>)
+    pop() noexcept
     {
         if (!empty())
         {
-            data_[front_].~value_type();
-            decrement();
+            slot(indices_.front())->~value_type();
+            indices_.pop();
+        }
+    }
+
+    // Removes all values
+    void
+    clear() noexcept
+    {
+        if constexpr (std::is_trivially_destructible_v<value_type>)
+        {
+            indices_ = {};
+        }
+        else
+        {
+            while (!empty())
+            {
+                pop();
+            }
         }
     }
 
@@ -128,74 +502,112 @@ public:
     size_type
     size() const noexcept
     {
-        return size_;
+        return indices_.size();
     }
 
     // Returns whether the buffer is empty
     bool
     empty() const noexcept
     {
-        return size_ == 0;
+        return size() == 0;
     }
 
     // Returns whether the buffer is full
     bool
     full() const noexcept
     {
-        return size_ == Capacity;
+        return size() == Capacity;
     }
 
     // Swaps this buffer with the given buffer
-    template <typename = std::enable_if_t<std::is_swappable_v<value_type>>>
+    template <typename T = value_type,
+              typename = std::enable_if_t<std::is_swappable_v<T>>>
     void
     swap(circular_buffer& other) noexcept(
-        std::is_nothrow_swappable_v<value_type>)
-    {
-        std::swap(end_, other.end_);
-        std::swap(front_, other.front_);
-        std::swap(size_, other.size_);
-        std::swap(data_, other.data_);
-    }
-
-private:
-    void
-    increment_or_wrap(size_type& value) const noexcept
+        std::is_nothrow_swappable_v<value_type>&&
+            std::is_nothrow_move_constructible_v<value_type>)
     {
-        if (value == Capacity - 1)
+        auto& larger = size() >= other.size() ? *this : other;
+        auto& smaller = size() >= other.size() ? other : *this;
+        const auto common = smaller.size();
+        for (size_type i = 0; i < common; ++i)
         {
-            value = 0;
+            using std::swap;
+            swap(larger.at(i), smaller.at(i));
         }
-        else
+        for (size_type i = common; i < larger.size(); ++i)
         {
-            ++value;
+            smaller.construct(std::move(larger.at(i)));
+        }
+        while (larger.size() > common)
+        {
+            larger.slot(larger.indices_.at(larger.size() - 1))->~value_type();
+            larger.indices_.pop_back();
         }
     }
 
-    void
-    increment() noexcept
+private:
+    using storage_type =
+        std::aligned_storage_t<sizeof(value_type), alignof(value_type)>;
+
+    static_assert(sizeof(storage_type) == sizeof(value_type),
+                  "values must be contiguous");
+
+    // Returns the number of values up to the end of the storage
+    size_type
+    first_run() const noexcept
     {
-        increment_or_wrap(end_);
-        if (full())
-        {
-            increment_or_wrap(front_);
-        }
-        else
-        {
-            ++size_;
-        }
+        return std::min(size(), Capacity - indices_.front());
     }
 
-    void
-    decrement() noexcept
+    // Returns the storage of the given slot as a destination for
+    // constructing values. No value lives there yet so it is not laundered
+    value_type*
+    storage(const size_type index) noexcept
     {
-        increment_or_wrap(front_);
-        --size_;
+        return reinterpret_cast<value_type*>(&data_[index]);
+    }
+
+    // Returns the live value in the given slot
+    value_type*
+    slot(const size_type index) noexcept
+    {
+        return std::launder(reinterpret_cast<value_type*>(&data_[index]));
+    }
+
+    const value_type*
+    slot(const size_type index) const noexcept
+    {
+        return std::launder(
+            reinterpret_cast<const value_type*>(&data_[index]));
+    }
+
+    // Returns the i-th value from the front
+    reference
+    at(const size_type i) noexcept
+    {
+        return *slot(indices_.at(i));
+    }
+
+    const_reference
+    at(const size_type i) const noexcept
+    {
+        return *slot(indices_.at(i));
+    }
+
+    // Constructs a value at the end of a buffer which is not full
+    template <typename... Args>
+    reference
+    construct(Args&&... args)
+    {
+        auto& value = *new (storage(indices_.end()))
+            value_type(std::forward<Args>(args)...);
+        indices_.push();
+        return value;
     }
 
-    size_type end_{};
-    size_type front_{};
-    size_type size_{};
-    value_type data_[Capacity];
+    gem::detail::circular_indices<Capacity> indices_;
+    storage_type data_[Capacity];
 };
 
 } // namespace gem
@@ -209,7 +621,7 @@ template <typename ValueType,
 void
 swap(gem::circular_buffer<ValueType, Capacity>& lhs,
      gem::circular_buffer<ValueType, Capacity>&
-         rhs) noexcept(std::is_nothrow_swappable_v<ValueType>)
+         rhs) noexcept(noexcept(lhs.swap(rhs)))
 {
     lhs.swap(rhs);
 }
@@ -1,10 +1,11 @@
 #pragma once
-
-#include <boost/lockfree/queue.hpp>
-
+#include "mpmc_circular_buffer.h"
 #include <cassert>
 #include <cstddef>
+#include <new>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace gem
 {
@@ -19,18 +20,27 @@ public:
                       "StorageCapacity not a power of 2");
         static_assert(is_power_of_2<QueueCapacity>::value,
                       "QueueCapacity not a power of 2");
-        assert(queue_.is_lock_free());
+        // the lock-free ring needs two slots to tell a full from a free slot
+        static_assert(QueueCapacity >= 2, "QueueCapacity must be at least 2");
     }
 
     template <typename Object, typename... Args>
     void
     push(Object* object, void (Object::*functor)(Args...), Args&&... args)
     {
-        command<Object, Args...> cmd{
-            object, functor, std::make_tuple(std::forward<Args>(args)...)};
-        static_assert(sizeof(cmd) <= sizeof(storage),
+        using command_type = command<Object, Args...>;
+        static_assert(sizeof(command_type) <= StorageCapacity &&
+                          alignof(command_type) <= alignof(std::max_align_t),
                       "storage capacity too small");
-        if (!queue_.push(reinterpret_cast<storage&>(cmd)))
+        static_assert(std::is_nothrow_move_constructible_v<command_type>,
+                      "arguments must be nothrow move constructible");
+        // built outside the queue so a throwing argument copy cannot leave a
+        // claimed slot behind, then moved into a slot by its move constructor
+        storage st{std::in_place_type<command_type>,
+                   object,
+                   functor,
+                   std::forward_as_tuple(std::forward<Args>(args)...)};
+        if (!queue_.try_push(std::move(st)))
         {
             assert(false && "queue push failed");
         }
@@ -40,11 +50,9 @@ public:
     sync()
     {
         storage st;
-        while (queue_.pop(st))
+        while (queue_.try_pop(st))
         {
-            auto& cmd = reinterpret_cast<command_base&>(st);
-            cmd.execute();
-            cmd.~command_base();
+            st.get().execute();
         }
     }
 
@@ -56,26 +64,95 @@ private:
         static constexpr bool value = input && !(input & (input - 1));
     };
 
-    struct storage
-    {
-        unsigned char data[StorageCapacity];
-    };
-
     struct command_base
     {
         virtual ~command_base() = default;
         virtual void execute() = 0;
+        // Move constructs this command at the given address
+        virtual void move_to(void* address) noexcept = 0;
+    };
+
+    // Holds at most one command and moves it with its own move constructor,
+    // so arguments pointing into themselves stay valid in the queue
+    class storage
+    {
+    public:
+        storage() noexcept = default;
+
+        template <typename Command, typename... CommandArgs>
+        explicit storage(std::in_place_type_t<Command>,
+                         CommandArgs&&... args)
+        {
+            new (&data_) Command(std::forward<CommandArgs>(args)...);
+            engaged_ = true;
+        }
+
+        ~storage()
+        {
+            reset();
+        }
+
+        // delete copy semantics
+        storage(const storage&) = delete;
+        storage& operator=(const storage&) = delete;
+
+        storage(storage&& other) noexcept
+        {
+            take(other);
+        }
+
+        storage&
+        operator=(storage&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                take(other);
+            }
+            return *this;
+        }
+
+        command_base&
+        get() noexcept
+        {
+            assert(engaged_);
+            return *std::launder(reinterpret_cast<command_base*>(&data_));
+        }
+
+    private:
+        void
+        take(storage& other) noexcept
+        {
+            if (other.engaged_)
+            {
+                other.get().move_to(&data_);
+                engaged_ = true;
+                other.reset();
+            }
+        }
+
+        void
+        reset() noexcept
+        {
+            if (engaged_)
+            {
+                get().~command_base();
+                engaged_ = false;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char data_[StorageCapacity];
+        bool engaged_ = false;
     };
 
     template <typename Object, typename... Args>
     struct command : command_base
     {
-        command(Object* object,
-                void (Object::*functor)(Args...),
-                std::tuple<Args...>&& args)
+        template <typename Tuple>
+        command(Object* object, void (Object::*functor)(Args...), Tuple&& args)
             : object{object}
             , functor{functor}
-            , args{std::move(args)}
+            , args{std::forward<Tuple>(args)}
         {
         }
 
@@ -85,6 +162,12 @@ private:
             call(std::index_sequence_for<Args...>{});
         }
 
+        void
+        move_to(void* address) noexcept override
+        {
+            new (address) command{std::move(*this)};
+        }
+
     private:
         template <std::size_t... Is>
         void call(std::index_sequence<Is...>)
@@ -97,8 +180,7 @@ private:
         std::tuple<Args...> args;
     };
 
-    boost::lockfree::queue<storage, boost::lockfree::capacity<QueueCapacity>>
-        queue_;
+    gem::mpmc_circular_buffer<storage, QueueCapacity> queue_;
 };
 
 } // namespace gem
@@ -0,0 +1,206 @@
+#pragma once
+#include "hashmap.h"
+#include "spinlock.h"
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+
+namespace gem
+{
+namespace detail
+{
+
+template <typename Mutex, typename = void>
+struct has_lock_shared : std::false_type
+{
+};
+
+template <typename Mutex>
+struct has_lock_shared<
+    Mutex,
+    std::void_t<decltype(std::declval<Mutex&>().lock_shared())>>
+    : std::true_type
+{
+};
+
+// Picks one of Shards shards for a key's hash from the upper bits of the
+// mixed hash since the shard's hashmap indexes its buckets with the lower
+// bits
+template <std::size_t Shards>
+std::size_t
+shard_index(const std::size_t hash)
+{
+    const auto mixed = static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>(mixed >> 40) & (Shards - 1);
+}
+
+} // namespace detail
+
+// A thread-safe hash map with string keys which is split into Shards
+// independent gem::hashmaps. Each shard is guarded by its own Mutex so that
+// operations on different shards proceed in parallel. Readers take a shared
+// lock if the Mutex supports it (e.g. std::shared_mutex). All functions
+// return copies of values instead of references into the map.
+template <typename ValueType,
+          std::size_t Shards = 16,
+          typename Mutex = gem::spinlock>
+class concurrent_hashmap
+{
+public:
+    static_assert(Shards > 0 && !(Shards & (Shards - 1)),
+                  "Shards must be a power of 2");
+
+    using value_type = ValueType;
+
+    concurrent_hashmap() = default;
+
+    // delete copy/move semantics
+    concurrent_hashmap(const concurrent_hashmap&) = delete;
+    concurrent_hashmap& operator=(const concurrent_hashmap&) = delete;
+    concurrent_hashmap(concurrent_hashmap&&) = delete;
+    concurrent_hashmap& operator=(concurrent_hashmap&&) = delete;
+
+    // Returns the number of entries. The result is only a snapshot if other
+    // threads modify the map concurrently
+    std::size_t
+    size() const
+    {
+        std::size_t size = 0;
+        for (const auto& s : shards_)
+        {
+            auto lock = read_lock(s);
+            size += s.map.size();
+        }
+        return size;
+    }
+
+    // Inserts or replaces the value of the given key and returns the previous
+    // value, if any
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        const auto h = hash(key);
+        auto& s = shard(h);
+        std::lock_guard lock{s.mutex};
+        return s.map.put_hashed(
+            std::forward<K>(key), h, std::forward<T>(value));
+    }
+
+    // Inserts the value only if the key does not exist yet. Returns the
+    // existing value if there is one, else nothing
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put_if_absent(K&& key, T&& value)
+    {
+        const auto h = hash(key);
+        auto& s = shard(h);
+        std::lock_guard lock{s.mutex};
+        if (const auto& current = s.map.get_hashed(key, h))
+        {
+            return current;
+        }
+        s.map.put_hashed(std::forward<K>(key), h, std::forward<T>(value));
+        return {};
+    }
+
+    // Atomically replaces the value of the given key with the result of
+    // functor(current) where current is a std::optional<value_type>. If the
+    // functor returns an empty optional the key is removed. Returns the new
+    // value. The functor runs under the shard's lock and must not access the
+    // map
+    template <typename K,
+              typename Functor,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view>>>
+    std::optional<value_type>
+    compute(K&& key, Functor&& functor)
+    {
+        const auto h = hash(key);
+        auto& s = shard(h);
+        std::lock_guard lock{s.mutex};
+        std::optional<value_type> value = functor(s.map.get_hashed(key, h));
+        if (value)
+        {
+            s.map.put_hashed(std::forward<K>(key), h, *value);
+        }
+        else
+        {
+            s.map.remove_hashed(key, h);
+        }
+        return value;
+    }
+
+    std::optional<value_type>
+    get(const std::string_view key) const
+    {
+        const auto h = hash(key);
+        const auto& s = shard(h);
+        auto lock = read_lock(s);
+        return s.map.get_hashed(key, h);
+    }
+
+    std::optional<value_type>
+    remove(const std::string_view key)
+    {
+        const auto h = hash(key);
+        auto& s = shard(h);
+        std::lock_guard lock{s.mutex};
+        return s.map.remove_hashed(key, h);
+    }
+
+private:
+    // shards live on separate cache lines to avoid false sharing
+    struct alignas(64) shard_type
+    {
+        mutable Mutex mutex;
+        gem::hashmap<value_type> map;
+    };
+
+    static auto
+    read_lock(const shard_type& s)
+    {
+        if constexpr (gem::detail::has_lock_shared<Mutex>::value)
+        {
+            return std::shared_lock{s.mutex};
+        }
+        else
+        {
+            return std::unique_lock{s.mutex};
+        }
+    }
+
+    // Keys are hashed once, the hash picks the shard and is passed on to the
+    // shard's map
+    static std::size_t
+    hash(const std::string_view key)
+    {
+        return gem::hash{}(key);
+    }
+
+    shard_type&
+    shard(const std::size_t hash)
+    {
+        return shards_[gem::detail::shard_index<Shards>(hash)];
+    }
+
+    const shard_type&
+    shard(const std::size_t hash) const
+    {
+        return shards_[gem::detail::shard_index<Shards>(hash)];
+    }
+
+    std::array<shard_type, Shards> shards_;
+};
+
+} // namespace gem
@@ -0,0 +1,266 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gem
+{
+
+// Epoch-based memory reclamation. Readers pin the domain for the duration of
+// a read-side critical section and writers retire unlinked objects instead of
+// deleting them. A retired object is deleted once every reader that might
+// still see it has unpinned, i.e. after the global epoch advanced twice.
+// Pinning claims one of the cache-line sized reader slots, so readers in
+// different threads do not touch shared cache lines. If every slot is taken
+// pinning appends another block of slots instead of waiting for a reader to
+// unpin, so it never blocks.
+class epoch_domain
+{
+public:
+    // A pinned read-side critical section
+    class guard
+    {
+    public:
+        explicit guard(std::atomic<std::uint64_t>& slot)
+            : slot_{&slot}
+        {
+        }
+
+        ~guard()
+        {
+            if (slot_)
+            {
+                slot_->store(0, std::memory_order_release);
+            }
+        }
+
+        // delete copy semantics
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+
+        guard(guard&& other) noexcept
+            : slot_{other.slot_}
+        {
+            other.slot_ = nullptr;
+        }
+
+        guard& operator=(guard&&) = delete;
+
+    private:
+        std::atomic<std::uint64_t>* slot_;
+    };
+
+    // Creates a domain with the given initial number of reader slots.
+    // Defaults to twice the number of hardware threads
+    explicit epoch_domain(const std::size_t slots = 2 *
+                              std::max(1u, std::thread::hardware_concurrency()))
+        : slots_{std::max<std::size_t>(1, slots)}
+    {
+    }
+
+    ~epoch_domain()
+    {
+        for (const auto& r : retired_)
+        {
+            r.deleter(r.ptr);
+        }
+        auto b = slots_.next.load(std::memory_order_relaxed);
+        while (b)
+        {
+            const auto next = b->next.load(std::memory_order_relaxed);
+            delete b;
+            b = next;
+        }
+    }
+
+    // delete copy/move semantics
+    epoch_domain(const epoch_domain&) = delete;
+    epoch_domain& operator=(const epoch_domain&) = delete;
+    epoch_domain(epoch_domain&&) = delete;
+    epoch_domain& operator=(epoch_domain&&) = delete;
+
+    // Enters a read-side critical section. Objects reachable after this call
+    // stay alive until the returned guard is destroyed
+    guard
+    pin()
+    {
+        const auto hint = thread_hint();
+        for (auto b = &slots_;;)
+        {
+            if (const auto state = claim(*b, hint))
+            {
+                return guard{*state};
+            }
+            auto next = b->next.load(std::memory_order_seq_cst);
+            if (!next)
+            {
+                next = append(*b);
+            }
+            b = next;
+        }
+    }
+
+    // Schedules the object for deletion once no reader can see it anymore.
+    // The object must already be unreachable for new readers
+    template <typename T>
+    void
+    retire(T* ptr)
+    {
+        std::lock_guard lock{retired_mutex_};
+        retired_.push_back({ptr,
+                            [](void* p) { delete static_cast<T*>(p); },
+                            epoch_.load(std::memory_order_seq_cst)});
+        if (retired_.size() >= next_reclaim_)
+        {
+            reclaim();
+        }
+    }
+
+    // Returns the number of objects waiting for deletion
+    std::size_t
+    retired() const
+    {
+        std::lock_guard lock{retired_mutex_};
+        return retired_.size();
+    }
+
+    // Tries to advance the epoch and deletes all objects that became safe to
+    // delete
+    void
+    collect()
+    {
+        std::lock_guard lock{retired_mutex_};
+        reclaim();
+    }
+
+private:
+    // retire reclaims once this many objects are pending. Afterwards the
+    // threshold is twice what is left, so a reader pinned for long does not
+    // turn every retire into a full scan
+    static constexpr std::size_t reclaim_threshold = 64;
+
+    struct alignas(64) slot
+    {
+        std::atomic<std::uint64_t> state{0};
+    };
+
+    // Blocks of slots form a list which only grows while the domain lives
+    struct slot_block
+    {
+        explicit slot_block(const std::size_t size)
+            : slots(size)
+        {
+        }
+
+        std::vector<slot> slots;
+        std::atomic<slot_block*> next{nullptr};
+    };
+
+    struct retired_object
+    {
+        void* ptr;
+        void (*deleter)(void*);
+        std::uint64_t epoch;
+    };
+
+    static std::size_t
+    thread_hint()
+    {
+        thread_local const std::size_t hint =
+            std::hash<std::thread::id>{}(std::this_thread::get_id());
+        return hint;
+    }
+
+    // Tries to pin one of the block's slots starting at the hint. Returns the
+    // state of the pinned slot or nullptr if all slots are taken
+    std::atomic<std::uint64_t>*
+    claim(slot_block& b, const std::size_t hint)
+    {
+        const auto size = b.slots.size();
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            auto& state = b.slots[(hint + i) % size].state;
+            std::uint64_t expected = 0;
+            const auto pinned =
+                (epoch_.load(std::memory_order_seq_cst) << 1) | 1;
+            if (state.load(std::memory_order_relaxed) == 0 &&
+                state.compare_exchange_strong(
+                    expected, pinned, std::memory_order_seq_cst))
+            {
+                return &state;
+            }
+        }
+        return nullptr;
+    }
+
+    // Appends a new block after the given last block and returns the block
+    // that follows it, which is another thread's if that one won the race
+    static slot_block*
+    append(slot_block& b)
+    {
+        auto block = new slot_block{b.slots.size()};
+        slot_block* expected = nullptr;
+        if (b.next.compare_exchange_strong(
+                expected, block, std::memory_order_seq_cst))
+        {
+            return block;
+        }
+        delete block;
+        return expected;
+    }
+
+    // Advances the epoch if every pinned reader has observed the current one
+    bool
+    try_advance()
+    {
+        auto epoch = epoch_.load(std::memory_order_seq_cst);
+        for (auto b = &slots_; b; b = b->next.load(std::memory_order_seq_cst))
+        {
+            for (const auto& s : b->slots)
+            {
+                const auto state = s.state.load(std::memory_order_seq_cst);
+                if (state != 0 && (state >> 1) != epoch)
+                {
+                    return false;
+                }
+            }
+        }
+        return epoch_.compare_exchange_strong(
+            epoch, epoch + 1, std::memory_order_seq_cst);
+    }
+
+    void
+    reclaim()
+    {
+        // objects retired in the current epoch need two advances
+        if (try_advance())
+        {
+            try_advance();
+        }
+        const auto epoch = epoch_.load(std::memory_order_seq_cst);
+        const auto safe = std::partition(
+            retired_.begin(), retired_.end(), [epoch](const auto& r) {
+                return r.epoch + 2 > epoch;
+            });
+        for (auto it = safe; it != retired_.end(); ++it)
+        {
+            it->deleter(it->ptr);
+        }
+        retired_.erase(safe, retired_.end());
+        next_reclaim_ = std::max(reclaim_threshold, 2 * retired_.size());
+    }
+
+    std::atomic<std::uint64_t> epoch_{0};
+    slot_block slots_;
+    std::vector<retired_object> retired_;
+    std::size_t next_reclaim_ = reclaim_threshold;
+    mutable std::mutex retired_mutex_;
+};
+
+} // namespace gem
@@ -0,0 +1,255 @@
+#pragma once
+#include "epoch.h"
+#include "hashmap.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace gem
+{
+namespace detail
+{
+
+// An immutable entry of an epoch_hashmap. Only the link to the next entry
+// changes after the node was published
+template <typename ValueType>
+struct epoch_node
+{
+    const std::string key;
+    const std::size_t hash;
+    const ValueType value;
+    std::atomic<epoch_node*> next;
+
+    epoch_node(std::string key,
+               const std::size_t hash,
+               ValueType value,
+               epoch_node* next)
+        : key{std::move(key)}
+        , hash{hash}
+        , value{std::move(value)}
+        , next{next}
+    {
+    }
+};
+
+// The bucket array of an epoch_hashmap. It owns the nodes linked into it
+template <typename ValueType>
+struct epoch_table
+{
+    using node_type = epoch_node<ValueType>;
+
+    std::unique_ptr<std::atomic<node_type*>[]> buckets;
+    std::size_t mask;
+
+    explicit epoch_table(const std::size_t count)
+        : buckets{new std::atomic<node_type*>[count]}
+        , mask{count - 1}
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            buckets[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~epoch_table()
+    {
+        for (std::size_t i = 0; i <= mask; ++i)
+        {
+            auto n = buckets[i].load(std::memory_order_relaxed);
+            while (n)
+            {
+                auto trash = n;
+                n = n->next.load(std::memory_order_relaxed);
+                delete trash;
+            }
+        }
+    }
+
+    std::atomic<node_type*>&
+    bucket(const std::size_t hash) const
+    {
+        return buckets[hash & mask];
+    }
+};
+
+} // namespace detail
+
+// A hash map with string keys whose get takes no lock at all. Readers walk
+// the bucket chains through atomics while pinned to an epoch_domain. Writers
+// are serialized by a mutex and never modify a published entry: an update
+// links in a new node and retires the old one, which is deleted once no
+// reader can hold it anymore. When the map holds as many entries as buckets
+// the writer publishes a doubled copy of the table and retires the old one.
+// Since readers cannot hold references into the map, get returns a copy.
+template <typename ValueType, std::size_t Buckets = 16>
+class epoch_hashmap
+{
+public:
+    static_assert(Buckets > 0, "Buckets must be larger than zero");
+
+    using value_type = ValueType;
+
+    epoch_hashmap()
+        : table_{new table_type{initial_buckets}}
+    {
+    }
+
+    ~epoch_hashmap()
+    {
+        delete table_.load(std::memory_order_relaxed);
+    }
+
+    // delete copy/move semantics
+    epoch_hashmap(const epoch_hashmap&) = delete;
+    epoch_hashmap& operator=(const epoch_hashmap&) = delete;
+    epoch_hashmap(epoch_hashmap&&) = delete;
+    epoch_hashmap& operator=(epoch_hashmap&&) = delete;
+
+    std::size_t
+    size() const
+    {
+        return size_.load(std::memory_order_relaxed);
+    }
+
+    // Inserts or replaces the value of the given key and returns the previous
+    // value, if any
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        std::lock_guard lock{writer_mutex_};
+        const auto h = hash(key);
+        auto table = table_.load(std::memory_order_relaxed);
+        auto link = &table->bucket(h);
+        for (auto n = link->load(std::memory_order_relaxed); n;
+             n = n->next.load(std::memory_order_relaxed))
+        {
+            if (n->hash == h && n->key == key)
+            {
+                auto replacement =
+                    new node_type{n->key,
+                                  h,
+                                  std::forward<T>(value),
+                                  n->next.load(std::memory_order_relaxed)};
+                link->store(replacement, std::memory_order_release);
+                std::optional<value_type> old_value = n->value;
+                domain_.retire(n);
+                return old_value;
+            }
+            link = &n->next;
+        }
+        if (size() >= table->mask + 1)
+        {
+            table = grow(table);
+        }
+        auto& b = table->bucket(h);
+        b.store(new node_type{std::string(std::forward<K>(key)),
+                              h,
+                              std::forward<T>(value),
+                              b.load(std::memory_order_relaxed)},
+                std::memory_order_release);
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+
+    // Returns a copy of the value of the given key. Never blocks
+    std::optional<value_type>
+    get(const std::string_view key) const
+    {
+        const auto guard = domain_.pin();
+        const auto h = hash(key);
+        const auto table = table_.load(std::memory_order_acquire);
+        for (auto n = table->bucket(h).load(std::memory_order_acquire); n;
+             n = n->next.load(std::memory_order_acquire))
+        {
+            if (n->hash == h && n->key == key)
+            {
+                return n->value;
+            }
+        }
+        return {};
+    }
+
+    std::optional<value_type>
+    remove(const std::string_view key)
+    {
+        std::lock_guard lock{writer_mutex_};
+        const auto h = hash(key);
+        const auto table = table_.load(std::memory_order_relaxed);
+        auto link = &table->bucket(h);
+        for (auto n = link->load(std::memory_order_relaxed); n;
+             n = n->next.load(std::memory_order_relaxed))
+        {
+            if (n->hash == h && n->key == key)
+            {
+                link->store(n->next.load(std::memory_order_relaxed),
+                            std::memory_order_release);
+                std::optional<value_type> old_value = n->value;
+                // readers standing on the node still see its successors
+                domain_.retire(n);
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return old_value;
+            }
+            link = &n->next;
+        }
+        return {};
+    }
+
+    // Returns the domain readers pin, e.g. to collect retired entries
+    gem::epoch_domain&
+    domain() const
+    {
+        return domain_;
+    }
+
+private:
+    using node_type = gem::detail::epoch_node<value_type>;
+    using table_type = gem::detail::epoch_table<value_type>;
+
+    static constexpr std::size_t initial_buckets =
+        gem::detail::next_power_of_2(Buckets);
+
+    // Publishes a copy of the table with twice the buckets. Readers still
+    // walking the old table keep it alive through the domain
+    table_type*
+    grow(table_type* table)
+    {
+        auto bigger = new table_type{(table->mask + 1) * 2};
+        for (std::size_t i = 0; i <= table->mask; ++i)
+        {
+            for (auto n = table->buckets[i].load(std::memory_order_relaxed); n;
+                 n = n->next.load(std::memory_order_relaxed))
+            {
+                auto& b = bigger->bucket(n->hash);
+                b.store(new node_type{n->key,
+                                      n->hash,
+                                      n->value,
+                                      b.load(std::memory_order_relaxed)},
+                        std::memory_order_relaxed);
+            }
+        }
+        table_.store(bigger, std::memory_order_release);
+        domain_.retire(table);
+        return bigger;
+    }
+
+    static std::size_t
+    hash(const std::string_view key)
+    {
+        return gem::hash{}(key);
+    }
+
+    std::atomic<table_type*> table_;
+    std::atomic<std::size_t> size_{0};
+    std::mutex writer_mutex_;
+    mutable gem::epoch_domain domain_;
+};
+
+} // namespace gem
@@ -0,0 +1,201 @@
+#pragma once
+#include "hashmap.h"
+#include "timer_wheel.h"
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace gem
+{
+namespace detail
+{
+
+// A value of an expiring_hashmap with the handle of its timer, if any
+template <typename ValueType, typename TimePoint>
+struct expiring_entry
+{
+    std::optional<ValueType> value;
+    std::optional<std::size_t> timer;
+    TimePoint deadline;
+};
+
+} // namespace detail
+
+// A hash map with string keys whose entries may expire. Entries put with a
+// time to live are scheduled in a gem::timer_wheel whose ticks are of the
+// given resolution. expire_until(now), e.g. called from an event loop,
+// removes all entries expired by then at a cost proportional to their
+// number. get never returns an expired entry but removes it instead, so
+// entries are exact to the Clock while expire_until is exact to the
+// resolution. The timers point at the keys stored in the map, so keys are
+// not copied for them.
+template <typename ValueType,
+          typename Clock = std::chrono::steady_clock,
+          std::size_t Buckets = 16>
+class expiring_hashmap
+{
+public:
+    using value_type = ValueType;
+    using clock = Clock;
+    using duration = typename Clock::duration;
+    using time_point = typename Clock::time_point;
+
+    explicit expiring_hashmap(
+        const duration resolution = std::chrono::milliseconds{1})
+        : resolution_{resolution}
+    {
+    }
+
+    // delete copy semantics, the timers point into this map's entries
+    expiring_hashmap(const expiring_hashmap&) = delete;
+    expiring_hashmap& operator=(const expiring_hashmap&) = delete;
+    // the moved-from map is empty
+    expiring_hashmap(expiring_hashmap&&) = default;
+    expiring_hashmap& operator=(expiring_hashmap&&) = default;
+
+    std::size_t
+    size() const
+    {
+        return map_.size();
+    }
+
+    // Inserts or replaces the value of the given key. The entry never
+    // expires
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        return put_entry(std::forward<K>(key),
+                         entry_type{std::forward<T>(value), {}, {}});
+    }
+
+    // Inserts or replaces the value of the given key which expires after the
+    // given time to live
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value, const duration ttl)
+    {
+        const auto deadline = Clock::now() + ttl;
+        // the timer gets the stored key once the entry is put
+        const auto timer = timers_.schedule(ceil_tick(deadline), nullptr);
+        return put_entry(std::forward<K>(key),
+                         entry_type{std::forward<T>(value), timer, deadline});
+    }
+
+    // Returns the value of the given key unless it has expired, in which case
+    // the entry is removed
+    const std::optional<value_type>&
+    get(const std::string_view key)
+    {
+        const auto& entry = map_.get(key);
+        if (!entry)
+        {
+            return empty_;
+        }
+        if (entry->timer && entry->deadline <= Clock::now())
+        {
+            remove(key);
+            return empty_;
+        }
+        return entry->value;
+    }
+
+    std::optional<value_type>
+    remove(const std::string_view key)
+    {
+        auto entry = map_.remove(key);
+        if (!entry)
+        {
+            return {};
+        }
+        if (entry->timer)
+        {
+            timers_.cancel(*entry->timer);
+        }
+        return std::move(entry->value);
+    }
+
+    // Removes all entries whose deadline lies in a tick before or at now and
+    // returns their number
+    std::size_t
+    expire_until(const time_point now)
+    {
+        return timers_.advance(floor_tick(now), [this](const std::string* key) {
+            map_.remove(*key);
+        });
+    }
+
+private:
+    using entry_type = gem::detail::expiring_entry<value_type, time_point>;
+
+    template <typename K>
+    std::optional<value_type>
+    put_entry(K&& key, entry_type&& entry)
+    {
+        const auto timer = entry.timer;
+        const auto h = map_.hash(key);
+        std::optional<entry_type> old_entry;
+        try
+        {
+            auto [old, stored] =
+                map_.put_stored(std::forward<K>(key), h, std::move(entry));
+            old_entry = std::move(old);
+            if (timer)
+            {
+                timers_.value(*timer) = stored;
+            }
+        }
+        catch (...)
+        {
+            if (timer)
+            {
+                timers_.cancel(*timer);
+            }
+            throw;
+        }
+        if (!old_entry)
+        {
+            return {};
+        }
+        if (old_entry->timer)
+        {
+            timers_.cancel(*old_entry->timer);
+        }
+        return std::move(old_entry->value);
+    }
+
+    std::uint64_t
+    floor_tick(const time_point time) const
+    {
+        const auto ticks = time.time_since_epoch() / resolution_;
+        return ticks > 0 ? static_cast<std::uint64_t>(ticks) : 0;
+    }
+
+    // Rounds up so that no entry expires before its deadline
+    std::uint64_t
+    ceil_tick(const time_point time) const
+    {
+        const auto tick = floor_tick(time);
+        const auto floor =
+            time_point{static_cast<typename duration::rep>(tick) * resolution_};
+        return floor < time ? tick + 1 : tick;
+    }
+
+    duration resolution_;
+    gem::hashmap<entry_type, Buckets> map_;
+    gem::timer_wheel<const std::string*> timers_;
+    std::optional<value_type> empty_;
+};
+
+} // namespace gem
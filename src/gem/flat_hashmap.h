@@ -0,0 +1,371 @@
+#pragma once
+#include "bits.h"
+#include "hash.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifndef GEM_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GEM_CTRL_GROUP_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GEM_CTRL_GROUP_SSE2
+#endif
+#endif
+
+namespace gem
+{
+namespace detail
+{
+
+// Control bytes of a flat_hashmap slot. A full slot stores the lower seven
+// bits of the key's hash (a non-negative value), empty and deleted slots are
+// marked with negative sentinels.
+enum class ctrl : std::int8_t
+{
+    empty = -128,
+    deleted = -2,
+};
+
+// A group of control bytes that is probed as a unit. With AVX2 a group of 32
+// bytes is matched by a single compare, with SSE2 a group of 16 bytes. Other
+// targets, or any target if GEM_NO_SIMD is defined, fall back to a loop over
+// 16 bytes.
+struct ctrl_group
+{
+#ifdef GEM_CTRL_GROUP_AVX2
+    static constexpr std::size_t width = 32;
+#else
+    static constexpr std::size_t width = 16;
+#endif
+
+    explicit ctrl_group(const std::int8_t* ctrl)
+        : ctrl{ctrl}
+    {
+    }
+
+    // Returns a bitmask of the slots whose control byte equals the given tag
+    std::uint32_t
+    match(const std::int8_t tag) const noexcept
+    {
+#if defined(GEM_CTRL_GROUP_AVX2)
+        const auto group =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl));
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_set1_epi8(tag), group)));
+#elif defined(GEM_CTRL_GROUP_SSE2)
+        const auto group =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), group)));
+#else
+        std::uint32_t mask = 0;
+        for (std::size_t i = 0; i < width; ++i)
+        {
+            if (ctrl[i] == tag)
+            {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+#endif
+    }
+
+    // Returns a bitmask of the empty slots
+    std::uint32_t
+    match_empty() const noexcept
+    {
+        return match(static_cast<std::int8_t>(gem::detail::ctrl::empty));
+    }
+
+    // Returns a bitmask of the empty or deleted slots
+    std::uint32_t
+    match_empty_or_deleted() const noexcept
+    {
+        // the sign bit is only set in empty and deleted slots
+#if defined(GEM_CTRL_GROUP_AVX2)
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl))));
+#elif defined(GEM_CTRL_GROUP_SSE2)
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))));
+#else
+        std::uint32_t mask = 0;
+        for (std::size_t i = 0; i < width; ++i)
+        {
+            if (ctrl[i] < 0)
+            {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+#endif
+    }
+
+    const std::int8_t* ctrl;
+};
+
+} // namespace detail
+
+// An open-addressing hash map with string keys. Keys, hashes and values are
+// kept in contiguous arrays next to an array of control bytes which carries
+// seven bits of each key's hash. Lookups probe whole groups of control bytes
+// and only compare keys whose tag matches, so a typical lookup touches one
+// control group and one slot. The table grows by doubling once it is seven
+// eighths full. References returned by get() are invalidated by put(). Hash
+// must hash a std::string_view.
+template <typename ValueType, typename Hash = gem::hash>
+class flat_hashmap
+{
+public:
+    using value_type = ValueType;
+
+    flat_hashmap() = default;
+
+    // default copy/move semantics
+    flat_hashmap(const flat_hashmap&) = default;
+    flat_hashmap& operator=(const flat_hashmap&) = default;
+
+    flat_hashmap(flat_hashmap&& other) noexcept
+    {
+        swap(other);
+    }
+
+    flat_hashmap&
+    operator=(flat_hashmap&& other) noexcept
+    {
+        if (this != &other)
+        {
+            flat_hashmap{}.swap(*this);
+            swap(other);
+        }
+        return *this;
+    }
+
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+
+    // Returns the number of slots
+    std::size_t
+    capacity() const
+    {
+        return ctrl_.size();
+    }
+
+    // Inserts or replaces the value of the given key. A std::string key is
+    // only constructed if the key does not exist yet
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        const auto hash = hash_(key);
+        if (const auto slot = find(key, hash); slot != npos)
+        {
+            auto old_value = std::move(values_[slot]);
+            values_[slot] = std::forward<T>(value);
+            return old_value;
+        }
+        if (size_ + deleted_ + 1 > max_load())
+        {
+            rehash();
+        }
+        const auto slot = find_free(hash);
+        if (ctrl_[slot] == static_cast<std::int8_t>(gem::detail::ctrl::deleted))
+        {
+            --deleted_;
+        }
+        ctrl_[slot] = tag(hash);
+        hashes_[slot] = hash;
+        keys_[slot] = std::string(std::forward<K>(key));
+        values_[slot] = std::forward<T>(value);
+        size_++;
+        return {};
+    }
+
+    const std::optional<value_type>&
+    get(const std::string_view key) const
+    {
+        const auto slot = find(key, hash_(key));
+        if (slot == npos)
+        {
+            return empty_;
+        }
+        return values_[slot];
+    }
+
+    std::optional<value_type>
+    remove(const std::string_view key)
+    {
+        const auto slot = find(key, hash_(key));
+        if (slot == npos)
+        {
+            return {};
+        }
+        auto old_value = std::move(values_[slot]);
+        values_[slot].reset();
+        keys_[slot].clear();
+        // probes only pass a group without empty slots, so the slot can only
+        // be marked empty if its group already had one
+        const auto group = slot - slot % gem::detail::ctrl_group::width;
+        if (gem::detail::ctrl_group{&ctrl_[group]}.match_empty())
+        {
+            ctrl_[slot] = static_cast<std::int8_t>(gem::detail::ctrl::empty);
+        }
+        else
+        {
+            ctrl_[slot] = static_cast<std::int8_t>(gem::detail::ctrl::deleted);
+            ++deleted_;
+        }
+        size_--;
+        return old_value;
+    }
+
+    void
+    swap(flat_hashmap& other) noexcept
+    {
+        std::swap(hash_, other.hash_);
+        std::swap(ctrl_, other.ctrl_);
+        std::swap(hashes_, other.hashes_);
+        std::swap(keys_, other.keys_);
+        std::swap(values_, other.values_);
+        std::swap(size_, other.size_);
+        std::swap(deleted_, other.deleted_);
+    }
+
+private:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    static constexpr std::size_t end_of_probe = npos - 1;
+    static constexpr std::size_t min_capacity = gem::detail::ctrl_group::width;
+
+    static std::int8_t
+    tag(const std::size_t hash) noexcept
+    {
+        return static_cast<std::int8_t>(hash & 0x7F);
+    }
+
+    std::size_t
+    groups() const noexcept
+    {
+        return ctrl_.size() / gem::detail::ctrl_group::width;
+    }
+
+    std::size_t
+    max_load() const noexcept
+    {
+        return ctrl_.size() - ctrl_.size() / 8;
+    }
+
+    // Visits groups along a triangular probe sequence which covers all groups
+    // because the number of groups is a power of two
+    template <typename Functor>
+    std::size_t
+    probe(const std::size_t hash, Functor&& functor) const
+    {
+        const auto mask = groups() - 1;
+        auto group = (hash >> 7) & mask;
+        for (std::size_t step = 1; step <= groups(); ++step)
+        {
+            const auto offset = group * gem::detail::ctrl_group::width;
+            if (const auto result =
+                    functor(offset, gem::detail::ctrl_group{&ctrl_[offset]});
+                result != npos)
+            {
+                return result;
+            }
+            group = (group + step) & mask;
+        }
+        return npos;
+    }
+
+    std::size_t
+    find(const std::string_view key, const std::size_t hash) const
+    {
+        if (size_ == 0)
+        {
+            return npos;
+        }
+        const auto h2 = tag(hash);
+        const auto slot =
+            probe(hash, [&](const std::size_t offset, const auto& group) {
+                auto mask = group.match(h2);
+                while (mask)
+                {
+                    const auto slot = offset + gem::detail::lowest_bit(mask);
+                    if (hashes_[slot] == hash && keys_[slot] == key)
+                    {
+                        return slot;
+                    }
+                    mask &= mask - 1;
+                }
+                // an empty slot terminates the probe sequence
+                return group.match_empty() ? end_of_probe : npos;
+            });
+        return slot == end_of_probe ? npos : slot;
+    }
+
+    std::size_t
+    find_free(const std::size_t hash) const
+    {
+        return probe(hash, [](const std::size_t offset, const auto& group) {
+            const auto mask = group.match_empty_or_deleted();
+            return mask ? offset + gem::detail::lowest_bit(mask) : npos;
+        });
+    }
+
+    void
+    rehash()
+    {
+        // drop tombstones in place if that frees enough room, else double
+        auto capacity = ctrl_.empty() ? min_capacity : ctrl_.size();
+        if (size_ + 1 > capacity / 2)
+        {
+            capacity = ctrl_.empty() ? min_capacity : capacity * 2;
+        }
+        flat_hashmap other;
+        other.hash_ = hash_;
+        other.ctrl_.assign(capacity,
+                           static_cast<std::int8_t>(gem::detail::ctrl::empty));
+        other.hashes_.resize(capacity);
+        other.keys_.resize(capacity);
+        other.values_.resize(capacity);
+        for (std::size_t slot = 0; slot < ctrl_.size(); ++slot)
+        {
+            if (ctrl_[slot] >= 0)
+            {
+                // reuse the stored hash instead of hashing the key again
+                const auto free = other.find_free(hashes_[slot]);
+                other.ctrl_[free] = ctrl_[slot];
+                other.hashes_[free] = hashes_[slot];
+                other.keys_[free] = std::move(keys_[slot]);
+                other.values_[free] = std::move(values_[slot]);
+            }
+        }
+        other.size_ = size_;
+        swap(other);
+    }
+
+    Hash hash_;
+    std::optional<value_type> empty_;
+    std::vector<std::int8_t> ctrl_;
+    std::vector<std::size_t> hashes_;
+    std::vector<std::string> keys_;
+    std::vector<std::optional<value_type>> values_;
+    std::size_t size_ = 0;
+    std::size_t deleted_ = 0;
+};
+
+} // namespace gem
@@ -0,0 +1,172 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+namespace gem
+{
+namespace detail
+{
+
+constexpr std::uint64_t wy_secret[4] = {0x2d358dccaa6c78a5ull,
+                                         0x8bb84b93962eacc9ull,
+                                         0x4b33a62ed433d4a3ull,
+                                         0x4d5a2da51de1aa47ull};
+
+// Multiplies two 64 bit values and replaces them with the low and high
+// halves of the 128 bit product
+inline void
+wy_mum(std::uint64_t& a, std::uint64_t& b) noexcept
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128;
+    const auto r = static_cast<uint128>(a) * b;
+    a = static_cast<std::uint64_t>(r);
+    b = static_cast<std::uint64_t>(r >> 64);
+#else
+    const std::uint64_t ha = a >> 32, hb = b >> 32;
+    const std::uint64_t la = a & 0xFFFFFFFFull, lb = b & 0xFFFFFFFFull;
+    const std::uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la,
+                        rl = la * lb;
+    const std::uint64_t t = rl + (rm0 << 32);
+    std::uint64_t c = t < rl;
+    const std::uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+inline std::uint64_t
+wy_mix(std::uint64_t a, std::uint64_t b) noexcept
+{
+    wy_mum(a, b);
+    return a ^ b;
+}
+
+inline std::uint64_t
+wy_read8(const unsigned char* p) noexcept
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+inline std::uint64_t
+wy_read4(const unsigned char* p) noexcept
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline std::uint64_t
+wy_read3(const unsigned char* p, const std::size_t k) noexcept
+{
+    return (static_cast<std::uint64_t>(p[0]) << 16) |
+        (static_cast<std::uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+}
+
+// A wyhash-style hash over a byte range
+inline std::uint64_t
+wy_hash(const void* key, const std::size_t len, std::uint64_t seed) noexcept
+{
+    auto p = static_cast<const unsigned char*>(key);
+    const auto& s = wy_secret;
+    seed ^= wy_mix(seed ^ s[0], s[1]);
+    std::uint64_t a, b;
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            const auto shift = (len >> 3) << 2;
+            a = (wy_read4(p) << 32) | wy_read4(p + shift);
+            b = (wy_read4(p + len - 4) << 32) | wy_read4(p + len - 4 - shift);
+        }
+        else if (len > 0)
+        {
+            a = wy_read3(p, len);
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        auto i = len;
+        if (i > 48)
+        {
+            auto see1 = seed, see2 = seed;
+            do
+            {
+                seed = wy_mix(wy_read8(p) ^ s[1], wy_read8(p + 8) ^ seed);
+                see1 = wy_mix(wy_read8(p + 16) ^ s[2], wy_read8(p + 24) ^ see1);
+                see2 = wy_mix(wy_read8(p + 32) ^ s[3], wy_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16)
+        {
+            seed = wy_mix(wy_read8(p) ^ s[1], wy_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wy_read8(p + i - 16);
+        b = wy_read8(p + i - 8);
+    }
+    a ^= s[1];
+    b ^= seed;
+    wy_mum(a, b);
+    return wy_mix(a ^ s[0] ^ len, b ^ s[1]);
+}
+
+} // namespace detail
+
+// The default hash of gem's hash maps. Hashes strings with a wyhash-style
+// function that reads eight bytes per step. It is transparent, so
+// std::string, std::string_view and C strings hash identically. Integral
+// keys are mixed with a single multiplication whose high bits are folded
+// into the low bits used for bucket indexing. Other trivially copyable keys
+// without padding (e.g. a 128 bit UUID) have their bytes hashed.
+struct hash
+{
+    using is_transparent = void;
+
+    std::size_t
+    operator()(const std::string_view key) const noexcept
+    {
+        return static_cast<std::size_t>(
+            gem::detail::wy_hash(key.data(), key.size(), 0));
+    }
+
+    template <typename Key,
+              typename = std::enable_if_t<std::is_integral_v<Key> ||
+                                          std::is_enum_v<Key>>>
+    std::size_t
+    operator()(const Key key) const noexcept
+    {
+        const auto h = static_cast<std::uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+        return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+
+    template <typename Key,
+              typename = std::enable_if_t<
+                  std::has_unique_object_representations_v<Key> &&
+                  !std::is_integral_v<Key> && !std::is_enum_v<Key> &&
+                  !std::is_convertible_v<const Key&, std::string_view>>,
+              typename = void>
+    std::size_t
+    operator()(const Key& key) const noexcept
+    {
+        return static_cast<std::size_t>(
+            gem::detail::wy_hash(&key, sizeof(Key), 0));
+    }
+};
+
+} // namespace gem
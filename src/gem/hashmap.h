@@ -1,42 +1,557 @@
 #pragma once
 #include "datastore.h"
-#include <array>
+#include "hash.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <ostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
 
 namespace gem
 {
 namespace detail
 {
 
-template <typename ValueType>
-struct node
+// A node holding just the key, its hash and the value
+template <typename Key, typename ValueType>
+struct plain_node
 {
-    std::optional<gem::ds::value<ValueType>> value;
-    node* next = nullptr;
+    Key key;
+    std::size_t hash;
+    std::optional<ValueType> value;
+    plain_node* next = nullptr;
 
-    node() = default;
+    template <
+        typename T,
+        typename = std::enable_if_t<std::is_same_v<std::decay_t<T>, ValueType>>>
+    plain_node(Key key, const std::size_t hash, T&& value)
+        : key{std::move(key)}
+        , hash{hash}
+        , value{std::forward<T>(value)}
+    {
+    }
+
+    const Key&
+    name() const
+    {
+        return key;
+    }
+
+    const std::optional<ValueType>&
+    get() const
+    {
+        return value;
+    }
+
+    template <typename T>
+    void
+    set(T&& value)
+    {
+        this->value = std::forward<T>(value);
+    }
+};
+
+// A node holding a shared gem::ds::value which can be observed
+template <typename Key, typename ValueType>
+struct observable_node
+{
+    static_assert(std::is_same_v<Key, std::string>,
+                  "Observable values require std::string keys");
+
+    std::shared_ptr<gem::ds::value<ValueType>> value;
+    std::size_t hash;
+    observable_node* next = nullptr;
 
     template <
         typename T,
         typename = std::enable_if_t<std::is_same_v<std::decay_t<T>, ValueType>>>
-    node(std::string key, T&& value)
-        : value{std::make_optional<gem::ds::value<ValueType>>(
+    observable_node(std::string key, const std::size_t hash, T&& value)
+        : value{std::make_shared<gem::ds::value<ValueType>>(
               std::move(key),
               std::forward<T>(value))}
+        , hash{hash}
+    {
+    }
+
+    const std::string&
+    name() const
+    {
+        return value->name();
+    }
+
+    const std::optional<ValueType>&
+    get() const
+    {
+        return value->get();
+    }
+
+    template <typename T>
+    void
+    set(T&& value)
     {
+        this->value->set(std::forward<T>(value));
     }
 };
 
 } // namespace detail
 
-template <typename ValueType, std::size_t Buckets = 0x10000>
+// Storage policy of gem::hashmap which stores plain key/value nodes
+struct plain_storage
+{
+    template <typename Key, typename ValueType>
+    using node = gem::detail::plain_node<Key, ValueType>;
+};
+
+// Storage policy of gem::hashmap which stores every value as a
+// gem::ds::value so that it can be observed, see hashmap::data()
+struct observable_storage
+{
+    template <typename Key, typename ValueType>
+    using node = gem::detail::observable_node<Key, ValueType>;
+};
+
+namespace detail
+{
+
+// A power-of-two sized array of bucket chains
+template <typename Node>
+struct bucket_array
+{
+    std::unique_ptr<Node*[]> buckets;
+    std::size_t mask = 0;
+
+    bucket_array() = default;
+
+    explicit bucket_array(const std::size_t count)
+        : buckets{new Node*[count]{}}
+        , mask{count - 1}
+    {
+    }
+
+    std::size_t
+    size() const
+    {
+        return buckets ? mask + 1 : 0;
+    }
+
+    Node*&
+    bucket(const std::size_t hash) const
+    {
+        return buckets[hash & mask];
+    }
+};
+
+// A forward iterator over the entries of a hashmap which visits both bucket
+// arrays in memory order. Dereferencing yields a pair of references to the
+// key and the value
+template <typename Node, typename Key, typename ValueType>
+class hashmap_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<const Key&, const ValueType&>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    hashmap_iterator() = default;
+
+    hashmap_iterator(const gem::detail::bucket_array<Node>* first,
+                     const gem::detail::bucket_array<Node>* second)
+        : tables_{first, second}
+    {
+        advance();
+    }
+
+    reference
+    operator*() const
+    {
+        return {node_->name(), *node_->get()};
+    }
+
+    hashmap_iterator&
+    operator++()
+    {
+        node_ = node_->next;
+        if (!node_)
+        {
+            ++bucket_;
+            advance();
+        }
+        return *this;
+    }
+
+    hashmap_iterator
+    operator++(int)
+    {
+        auto copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    bool
+    operator==(const hashmap_iterator& other) const
+    {
+        return node_ == other.node_;
+    }
+
+    bool
+    operator!=(const hashmap_iterator& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    // Moves to the first node at or after the current bucket
+    void
+    advance()
+    {
+        for (; table_ < 2; ++table_, bucket_ = 0)
+        {
+            for (; bucket_ < tables_[table_]->size(); ++bucket_)
+            {
+                if ((node_ = tables_[table_]->buckets[bucket_]))
+                {
+                    return;
+                }
+            }
+        }
+        node_ = nullptr;
+    }
+
+    const gem::detail::bucket_array<Node>* tables_[2] = {};
+    std::size_t table_ = 0;
+    std::size_t bucket_ = 0;
+    Node* node_ = nullptr;
+};
+
+// Hints the CPU to fetch the cache line of the given address
+inline void
+prefetch(const void* address) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(_M_X64) || defined(_M_IX86)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+template <typename Allocator, typename = void>
+struct has_release : std::false_type
+{
+};
+
+template <typename Allocator>
+struct has_release<Allocator,
+                   std::void_t<decltype(std::declval<Allocator&>().release())>>
+    : std::true_type
+{
+};
+
+template <typename Allocator, typename = void>
+struct has_reserve : std::false_type
+{
+};
+
+template <typename Allocator>
+struct has_reserve<Allocator,
+                   std::void_t<decltype(std::declval<Allocator&>().reserve(
+                       std::size_t{}))>> : std::true_type
+{
+};
+
+// Returns the smallest power of 2 not less than value. Throws
+// std::length_error if that does not fit into a std::size_t
+constexpr std::size_t
+next_power_of_2(const std::size_t value)
+{
+    constexpr auto largest = (std::numeric_limits<std::size_t>::max() >> 1) + 1;
+    if (value > largest)
+    {
+        throw std::length_error{"No power of 2 is large enough"};
+    }
+    std::size_t result = 1;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace detail
+
+class serialization_error : public std::runtime_error
+{
+public:
+    explicit serialization_error(const std::string& message)
+        : std::runtime_error{message}
+    {
+    }
+};
+
+namespace detail
+{
+
+constexpr char hashmap_magic[8] = {'g', 'e', 'm', 'h', 'm', 'a', 'p', '1'};
+
+// Writes the value as a LEB128 varint
+inline void
+write_varint(std::ostream& out, std::uint64_t value)
+{
+    char bytes[10];
+    std::size_t count = 0;
+    do
+    {
+        const auto more = value > 0x7F ? 0x80 : 0;
+        bytes[count++] = static_cast<char>((value & 0x7F) | more);
+        value >>= 7;
+    } while (value);
+    out.write(bytes, static_cast<std::streamsize>(count));
+}
+
+inline std::uint64_t
+read_varint(std::istream& in)
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        const auto byte = in.get();
+        if (byte == std::istream::traits_type::eof())
+        {
+            break;
+        }
+        // the tenth byte only holds bit 63 and ends the varint
+        if (shift == 63 && byte > 1)
+        {
+            break;
+        }
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return value;
+        }
+    }
+    throw gem::serialization_error{"Truncated or invalid varint"};
+}
+
+// Writes a std::string as its length and bytes and any other trivially
+// copyable type as its object representation
+template <typename T>
+void
+write_field(std::ostream& out, const T& value)
+{
+    if constexpr (std::is_same_v<T, std::string>)
+    {
+        write_varint(out, value.size());
+        out.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+    else
+    {
+        static_assert(std::is_trivially_copyable_v<T>,
+                      "Only std::string and trivially copyable types can be "
+                      "serialized");
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+}
+
+template <typename T>
+T
+read_field(std::istream& in)
+{
+    if constexpr (std::is_same_v<T, std::string>)
+    {
+        const auto size = read_varint(in);
+        T value;
+        if (size > value.max_size())
+        {
+            throw gem::serialization_error{"Invalid string length"};
+        }
+        // grows as the bytes arrive so that a corrupt length fails on
+        // truncation instead of allocating it up front
+        constexpr std::uint64_t chunk = 1 << 16;
+        while (value.size() < size)
+        {
+            const auto offset = value.size();
+            const auto count =
+                static_cast<std::size_t>(std::min(size - offset, chunk));
+            value.resize(offset + count);
+            if (!in.read(value.data() + offset,
+                         static_cast<std::streamsize>(count)))
+            {
+                throw gem::serialization_error{"Truncated string"};
+            }
+        }
+        return value;
+    }
+    else
+    {
+        static_assert(std::is_trivially_copyable_v<T> &&
+                          std::is_default_constructible_v<T>,
+                      "Only std::string and trivially copyable types can be "
+                      "deserialized");
+        T value;
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+}
+
+} // namespace detail
+
+// Operation counts of a gem::hashmap, see hashmap::stats()
+struct hashmap_counts
+{
+    std::size_t puts = 0;
+    std::size_t gets = 0;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t removes = 0;
+};
+
+// How the entries of a gem::hashmap are spread over its buckets. During a
+// rehash the buckets of both arrays are included
+struct hashmap_stats
+{
+    std::size_t size = 0;
+    std::size_t bucket_count = 0;
+    // The number of buckets holding at least one entry
+    std::size_t occupied_buckets = 0;
+    std::size_t max_chain = 0;
+    // The mean length of the non-empty chains
+    double mean_chain = 0;
+    // Element i is the number of entries found after visiting i + 1 nodes
+    std::vector<std::size_t> probe_lengths;
+    // The bytes taken by the map, its bucket arrays and nodes. Memory owned
+    // by keys or values and allocator overhead are not included
+    std::size_t memory = 0;
+    // All zero unless the map counts its operations
+    gem::hashmap_counts counts;
+};
+
+namespace detail
+{
+
+// Counts the operations of a hashmap. Does nothing unless enabled
+template <bool Enabled>
+struct hashmap_counters
+{
+    void
+    put() const
+    {
+    }
+
+    void
+    get(bool) const
+    {
+    }
+
+    void
+    remove() const
+    {
+    }
+
+    gem::hashmap_counts
+    load() const
+    {
+        return {};
+    }
+};
+
+template <>
+struct hashmap_counters<true>
+{
+    void
+    put()
+    {
+        puts.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void
+    get(const bool hit)
+    {
+        (hit ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void
+    remove()
+    {
+        removes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    gem::hashmap_counts
+    load() const
+    {
+        gem::hashmap_counts counts;
+        counts.puts = puts.load(std::memory_order_relaxed);
+        counts.hits = hits.load(std::memory_order_relaxed);
+        counts.misses = misses.load(std::memory_order_relaxed);
+        counts.gets = counts.hits + counts.misses;
+        counts.removes = removes.load(std::memory_order_relaxed);
+        return counts;
+    }
+
+    std::atomic<std::size_t> puts{0};
+    std::atomic<std::size_t> hits{0};
+    std::atomic<std::size_t> misses{0};
+    std::atomic<std::size_t> removes{0};
+};
+
+} // namespace detail
+
+// A hash map with separate chaining. Buckets is the initial
+// number of buckets (rounded up to a power of two) which is only allocated
+// with the first put. Once the number of entries reaches the number of
+// buckets the bucket array is doubled. Entries are then migrated from the old
+// to the new array a few buckets at a time with every put so that no single
+// put pays for the whole rehash. Storage selects the node type, either
+// gem::plain_storage or gem::observable_storage. Hash must hash a key_type,
+// or a std::string_view for std::string keys. Every node caches its hash
+// which is compared before the key when walking a chain and reused when
+// entries are rehashed or copied. Nodes are allocated through Allocator, e.g.
+// gem::node_pool to allocate them from slabs. Key defaults to std::string
+// which is looked up by std::string_view; any other key is stored inline and
+// looked up as is, so integral and trivially copyable keys never allocate.
+// gem::basic_hashmap takes the key type first for such maps.
+// With Counters the map counts puts, gets, hits, misses and removes, see
+// stats(); without them no counting code is compiled in.
+template <typename ValueType,
+          std::size_t Buckets = 16,
+          typename Storage = gem::plain_storage,
+          typename Hash = gem::hash,
+          typename Allocator = std::allocator<ValueType>,
+          typename Key = std::string,
+          bool Counters = false>
 class hashmap
 {
 public:
     static_assert(Buckets > 0, "Buckets must be larger than zero");
 
+    using key_type = Key;
     using value_type = ValueType;
+    // The type keys are looked up with
+    using lookup_type = std::
+        conditional_t<std::is_same_v<Key, std::string>, std::string_view, Key>;
+    using const_iterator = gem::detail::hashmap_iterator<
+        typename Storage::template node<Key, ValueType>,
+        Key,
+        ValueType>;
 
     hashmap() = default;
 
@@ -46,6 +561,8 @@ public:
     }
 
     hashmap(const hashmap& other)
+        : allocator_{allocator_traits::select_on_container_copy_construction(
+              other.allocator_)}
     {
         copy_from(other);
     }
@@ -85,157 +602,696 @@ public:
         return size_;
     }
 
-    template <typename T,
-              typename =
-                  std::enable_if_t<std::is_same_v<std::decay_t<T>, value_type>>>
+    // Returns the number of buckets entries are currently inserted into
+    std::size_t
+    bucket_count() const
+    {
+        return table_.size();
+    }
+
+    // Inserts or replaces the value of the given key. A key_type is only
+    // constructed if the key does not exist yet
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, lookup_type> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        const auto h = hash(key);
+        return put_hashed(std::forward<K>(key), h, std::forward<T>(value));
+    }
+
+    const std::optional<value_type>&
+    get(const lookup_type& key) const
+    {
+        return get_hashed(key, hash(key));
+    }
+
+    // Returns the hash of the given key. A caller which hashes keys anyway,
+    // e.g. to pick a shard, passes it to the *_hashed functions so that the
+    // key is not hashed twice
+    std::size_t
+    hash(const lookup_type& key) const
+    {
+        return hash_(key);
+    }
+
+    // Same as put() where h must be hash(key)
+    template <typename K, typename T>
     std::optional<value_type>
-    put(std::string key, T&& value)
+    put_hashed(K&& key, const std::size_t h, T&& value)
+    {
+        return put_stored(std::forward<K>(key), h, std::forward<T>(value))
+            .first;
+    }
+
+    // Same as put_hashed() but also returns the key stored in the map. Nodes
+    // are relinked but never moved, so the stored key keeps its address
+    // until its entry is removed
+    template <typename K, typename T>
+    std::pair<std::optional<value_type>, const key_type*>
+    put_stored(K&& key, const std::size_t h, T&& value)
     {
-        auto& b = bucket(key);
-        if (!b)
+        counters_.put();
+        if (const auto n = find(key, h))
         {
-            b = new gem::detail::node<value_type>{}; // creating head
-            b->next = new gem::detail::node<value_type>{std::move(key),
-                                                        std::forward<T>(value)};
-            size_++;
-            return {};
+            auto old_value = n->get();
+            n->set(std::forward<T>(value));
+            return {std::move(old_value), &n->name()};
+        }
+        if (!table_.buckets)
+        {
+            table_ = bucket_array{initial_buckets};
+        }
+        else if (!old_.buckets && size_ >= table_.size())
+        {
+            grow();
+        }
+        auto& b = table_.bucket(h);
+        auto n = new_node(
+            key_type(std::forward<K>(key)), h, std::forward<T>(value));
+        n->next = b;
+        b = n;
+        size_++;
+        migrate();
+        return {std::nullopt, &n->name()};
+    }
+
+    // Same as get() where h must be hash(key)
+    const std::optional<value_type>&
+    get_hashed(const lookup_type& key, const std::size_t h) const
+    {
+        const auto n = find(key, h);
+        counters_.get(n != nullptr);
+        return n ? n->get() : empty_;
+    }
+
+    // Looks up all keys in [first, last) and writes a reference to each
+    // result (see get()) to out. Keys are handled in blocks: all keys of a
+    // block are hashed and their buckets and chain heads prefetched before
+    // any of them is resolved, so that the cache misses overlap. Keys the
+    // iterator returns by value are copied for the block
+    template <typename ForwardIt, typename OutputIt>
+    OutputIt
+    get_many(ForwardIt first, const ForwardIt last, OutputIt out) const
+    {
+        // a lookup_type of a temporary would dangle before it is resolved
+        using block_key = std::conditional_t<
+            std::is_lvalue_reference_v<decltype(*first)>,
+            lookup_type,
+            key_type>;
+        block_key keys[batch_size];
+        std::size_t hashes[batch_size];
+        while (first != last)
+        {
+            std::size_t count = 0;
+            for (; first != last && count < batch_size; ++first, ++count)
+            {
+                keys[count] = *first;
+                hashes[count] = hash(keys[count]);
+            }
+            prefetch(hashes, count);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto n = find(keys[i], hashes[i]);
+                counters_.get(n != nullptr);
+                *out++ = n ? n->get() : empty_;
+            }
         }
-        auto n = b->next;
-        for (;;)
+        return out;
+    }
+
+    // Puts all key/value pairs of [first, last), e.g. a range of std::pair.
+    // Hashing and prefetching is done in blocks as in get_many()
+    template <typename ForwardIt>
+    void
+    put_many(ForwardIt first, const ForwardIt last)
+    {
+        std::size_t hashes[batch_size];
+        while (first != last)
         {
-            if (n->value->name() == key)
+            auto block = first;
+            std::size_t count = 0;
+            for (; first != last && count < batch_size; ++first, ++count)
             {
-                auto old_value = n->value->get();
-                n->value->set(std::forward<T>(value));
-                return old_value;
+                hashes[count] = hash(first->first);
             }
-            if (!n->next)
+            prefetch(hashes, count);
+            for (std::size_t i = 0; i < count; ++i, ++block)
             {
-                break;
+                put_hashed(block->first, hashes[i], block->second);
             }
-            n = n->next;
-        };
-        n->next = new gem::detail::node<value_type>{std::move(key),
-                                                    std::forward<T>(value)};
-        size_++;
-        return {};
+        }
     }
 
-    const std::optional<value_type>&
-    get(const std::string& key) const
+    // Makes room for count entries: the bucket array is rehashed once to
+    // hold them without growing and an allocator with reserve() (e.g.
+    // gem::node_pool) is asked to make room for the nodes
+    void
+    reserve(const std::size_t count)
     {
-        auto b = bucket(key);
-        if (!b)
+        const auto buckets =
+            gem::detail::next_power_of_2(std::max(count, initial_buckets));
+        if (buckets > table_.size())
         {
-            return empty_;
+            rehash(buckets);
         }
-        b = b->next;
-        while (b)
+        if constexpr (gem::detail::has_reserve<node_allocator>::value)
         {
-            if (b->value->name() == key)
+            if (count > size_)
             {
-                return b->value->get();
+                allocator_.reserve(count - size_);
             }
-            b = b->next;
-        };
-        return empty_;
+        }
+    }
+
+    // Puts all key/value pairs of a forward range after reserving room for
+    // all of them, so that the table never grows while loading. Nodes are
+    // only preallocated in one go with an allocator that has reserve(), such
+    // as gem::node_pool; std::allocator still allocates each node on its own
+    template <typename ForwardIt>
+    void
+    bulk_load(const ForwardIt first, const ForwardIt last)
+    {
+        reserve(size_ + static_cast<std::size_t>(std::distance(first, last)));
+        put_many(first, last);
+    }
+
+    // Writes all entries to a binary stream. Keys and values must be
+    // std::string or trivially copyable, the latter are written in the byte
+    // order of the machine
+    void
+    save(std::ostream& out) const
+    {
+        out.write(gem::detail::hashmap_magic,
+                  sizeof(gem::detail::hashmap_magic));
+        gem::detail::write_varint(out, size_);
+        for_each([&out](const key_type& key, const value_type& value) {
+            gem::detail::write_field(out, key);
+            gem::detail::write_field(out, value);
+        });
+        if (!out)
+        {
+            throw gem::serialization_error{"Unable to write hashmap"};
+        }
+    }
+
+    // Puts all entries of a stream written by save(). Room for the entries
+    // is reserved up front, up to a bound so that a corrupt count cannot
+    // exhaust memory; beyond it the map grows as entries arrive
+    void
+    load(std::istream& in)
+    {
+        char magic[sizeof(gem::detail::hashmap_magic)];
+        if (!in.read(magic, sizeof(magic)) ||
+            !std::equal(std::begin(magic),
+                        std::end(magic),
+                        std::begin(gem::detail::hashmap_magic)))
+        {
+            throw gem::serialization_error{"Not a serialized hashmap"};
+        }
+        const auto count = gem::detail::read_varint(in);
+        if (count > std::numeric_limits<std::size_t>::max() - size_)
+        {
+            throw gem::serialization_error{"Invalid entry count"};
+        }
+        reserve(size_ + static_cast<std::size_t>(
+                            std::min<std::uint64_t>(count, max_load_reserve)));
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            auto key = gem::detail::read_field<key_type>(in);
+            auto value = gem::detail::read_field<value_type>(in);
+            if (!in)
+            {
+                throw gem::serialization_error{"Truncated hashmap"};
+            }
+            const auto h = hash(key);
+            put_hashed(std::move(key), h, std::move(value));
+        }
+    }
+
+    // Returns the observable value of the given key or null if the key does
+    // not exist. Only available with gem::observable_storage
+    template <typename S = Storage,
+              typename = std::enable_if_t<
+                  std::is_same_v<S, gem::observable_storage>>>
+    std::shared_ptr<gem::ds::value<value_type>>
+    data(const lookup_type& key) const
+    {
+        if (const auto n = find(key, hash(key)))
+        {
+            return n->value;
+        }
+        return nullptr;
     }
 
     std::optional<value_type>
-    remove(const std::string& key)
+    remove(const lookup_type& key)
     {
-        auto& b = bucket(key);
-        if (!b)
+        return remove_hashed(key, hash(key));
+    }
+
+    // Same as remove() where h must be hash(key)
+    std::optional<value_type>
+    remove_hashed(const lookup_type& key, const std::size_t h)
+    {
+        counters_.remove();
+        auto n = unlink(table_, h, key);
+        if (!n && old_.buckets)
+        {
+            n = unlink(old_, h, key);
+        }
+        if (!n)
         {
             return {};
         }
-        auto p = b;
-        auto n = b->next;
-        while (n)
+        auto old_value = n->get();
+        delete_node(n);
+        size_--;
+        return old_value;
+    }
+
+    const_iterator
+    begin() const
+    {
+        return const_iterator{&old_, &table_};
+    }
+
+    const_iterator
+    end() const
+    {
+        return {};
+    }
+
+    // Calls functor(key, value) for every entry in memory order
+    template <typename Functor>
+    void
+    for_each(Functor&& functor) const
+    {
+        for_each_in(0, old_.size() + table_.size(), functor);
+    }
+
+    // Calls functor(key, value) for every entry from the given number of
+    // threads, at most one per hardware thread, each walking a contiguous
+    // range of buckets. The functor must be safe to call concurrently
+    template <typename Functor>
+    void
+    parallel_for_each(Functor&& functor,
+                      const std::size_t threads = default_threads()) const
+    {
+        parallel_reduce(
+            0,
+            [&functor](const key_type& key, const value_type& value) {
+                functor(key, value);
+                return 0;
+            },
+            [](int, int) { return 0; },
+            threads);
+    }
+
+    // Maps every entry with mapper(key, value) and combines the results with
+    // reducer(lhs, rhs) from the given number of threads, at most one per
+    // hardware thread. Each thread starts from identity and the partial
+    // results are combined in bucket order
+    template <typename T, typename Mapper, typename Reducer>
+    T
+    parallel_reduce(T identity,
+                    Mapper&& mapper,
+                    Reducer&& reducer,
+                    const std::size_t threads = default_threads()) const
+    {
+        const auto buckets = old_.size() + table_.size();
+        const auto chunks = std::max<std::size_t>(
+            1, std::min({threads, buckets, default_threads()}));
+        const auto reduce_chunk = [&](const std::size_t chunk) {
+            auto result = identity;
+            for_each_in(chunk * buckets / chunks,
+                        (chunk + 1) * buckets / chunks,
+                        [&](const key_type& key, const value_type& value) {
+                            result = reducer(std::move(result),
+                                             mapper(key, value));
+                        });
+            return result;
+        };
+        std::vector<std::future<T>> futures;
+        for (std::size_t chunk = 1; chunk < chunks; ++chunk)
         {
-            if (n->value->name() == key)
+            futures.push_back(
+                std::async(std::launch::async, reduce_chunk, chunk));
+        }
+        auto result = reduce_chunk(0);
+        for (auto& future : futures)
+        {
+            result = reducer(std::move(result), future.get());
+        }
+        return result;
+    }
+
+    // Walks all buckets and returns how the entries are distributed along
+    // with the operation counts
+    gem::hashmap_stats
+    stats() const
+    {
+        gem::hashmap_stats stats;
+        stats.size = size_;
+        stats.bucket_count = old_.size() + table_.size();
+        for (const auto table : {&old_, &table_})
+        {
+            for (std::size_t i = 0; i < table->size(); ++i)
             {
-                auto old_value = n->value->get();
-                if (n == b->next && !n->next)
+                std::size_t chain = 0;
+                for (auto n = table->buckets[i]; n; n = n->next)
                 {
-                    // deleting head
-                    delete b;
-                    b = nullptr;
+                    if (stats.probe_lengths.size() <= chain)
+                    {
+                        stats.probe_lengths.push_back(0);
+                    }
+                    stats.probe_lengths[chain++]++;
+                }
+                if (chain)
+                {
+                    stats.occupied_buckets++;
+                    stats.max_chain = std::max(stats.max_chain, chain);
                 }
-                p->next = n->next;
-                delete n;
-                size_--;
-                return old_value;
             }
-            p = n;
-            n = n->next;
-        };
-        return {};
+        }
+        if (stats.occupied_buckets)
+        {
+            stats.mean_chain = static_cast<double>(size_) /
+                static_cast<double>(stats.occupied_buckets);
+        }
+        stats.memory = sizeof(*this) + size_ * sizeof(node_type) +
+            stats.bucket_count * sizeof(node_type*);
+        stats.counts = counters_.load();
+        return stats;
     }
 
 private:
+    using node_type = typename Storage::template node<key_type, value_type>;
+    using bucket_array = gem::detail::bucket_array<node_type>;
+    using node_allocator = typename std::allocator_traits<
+        Allocator>::template rebind_alloc<node_type>;
+    using allocator_traits = std::allocator_traits<node_allocator>;
+
+    static std::size_t
+    default_threads()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Calls functor(key, value) for every entry of the buckets in the given
+    // range where the buckets of the old array come first
+    template <typename Functor>
+    void
+    for_each_in(const std::size_t first,
+                const std::size_t last,
+                Functor&& functor) const
+    {
+        std::size_t offset = 0;
+        for (const auto table : {&old_, &table_})
+        {
+            const auto size = table->size();
+            const auto begin = first > offset ? first - offset : 0;
+            const auto end = last > offset ? std::min(last - offset, size) : 0;
+            for (auto i = begin; i < end; ++i)
+            {
+                for (auto n = table->buckets[i]; n; n = n->next)
+                {
+                    functor(n->name(), *n->get());
+                }
+            }
+            offset += size;
+        }
+    }
+
+    static constexpr std::size_t initial_buckets =
+        gem::detail::next_power_of_2(Buckets);
+    // the most entries load() reserves room for before reading them
+    static constexpr std::size_t max_load_reserve = std::size_t{1} << 20;
+
+    // The number of keys hashed and prefetched together by the batch
+    // operations
+    static constexpr std::size_t batch_size = 16;
+
+    // Prefetches the buckets of the given hashes in both arrays and then the
+    // heads of their chains
+    void
+    prefetch(const std::size_t* hashes, const std::size_t count) const
+    {
+        for (const auto table : {&table_, &old_})
+        {
+            if (table->buckets)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    gem::detail::prefetch(&table->bucket(hashes[i]));
+                }
+            }
+        }
+        for (const auto table : {&table_, &old_})
+        {
+            if (table->buckets)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    gem::detail::prefetch(table->bucket(hashes[i]));
+                }
+            }
+        }
+    }
+
+    // The number of old buckets migrated per put. Migration must finish
+    // before the new array fills up, which takes at least as many puts as
+    // there are old buckets
+    static constexpr std::size_t migration_step = 8;
+
+    // Clones all entries of the other map into a bucket array of the same
+    // size without hashing any key again
     void
     copy_from(const hashmap& other)
     {
-        for (auto b : other.buckets_)
+        hash_ = other.hash_;
+        if (!other.size_)
+        {
+            return;
+        }
+        table_ = bucket_array{other.table_.size()};
+        for (const auto table : {&other.old_, &other.table_})
         {
-            if (b)
+            for (std::size_t i = 0; i < table->size(); ++i)
             {
-                b = b->next;
-                while (b)
+                for (auto n = table->buckets[i]; n; n = n->next)
                 {
-                    put(b->value->name(), *b->value->get());
-                    b = b->next;
+                    auto& b = table_.bucket(n->hash);
+                    auto copy = new_node(n->name(), n->hash, *n->get());
+                    copy->next = b;
+                    b = copy;
                 }
             }
         }
+        size_ = other.size_;
     }
 
     void
     move_from(hashmap&& other)
     {
-        std::swap(buckets_, other.buckets_);
+        std::swap(hash_, other.hash_);
+        std::swap(allocator_, other.allocator_);
+        std::swap(table_, other.table_);
+        std::swap(old_, other.old_);
+        std::swap(migrated_, other.migrated_);
         std::swap(size_, other.size_);
     }
 
+    // Destroys all nodes. Nodes which need no destruction are released in
+    // bulk if the allocator supports it (e.g. gem::node_pool)
     void
     destroy()
     {
-        for (auto b : buckets_)
+        if constexpr (std::is_trivially_destructible_v<node_type> &&
+                      gem::detail::has_release<node_allocator>::value)
+        {
+            allocator_.release();
+            return;
+        }
+        for (const auto table : {&old_, &table_})
         {
-            while (b)
+            for (std::size_t i = 0; i < table->size(); ++i)
             {
-                auto trash = b;
-                b = b->next;
-                delete trash;
+                auto n = table->buckets[i];
+                while (n)
+                {
+                    auto trash = n;
+                    n = n->next;
+                    delete_node(trash);
+                }
             }
         }
     }
 
+    template <typename... Args>
+    node_type*
+    new_node(Args&&... args)
+    {
+        const auto n = allocator_traits::allocate(allocator_, 1);
+        try
+        {
+            allocator_traits::construct(
+                allocator_, n, std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            allocator_traits::deallocate(allocator_, n, 1);
+            throw;
+        }
+        return n;
+    }
+
+    void
+    delete_node(node_type* n)
+    {
+        allocator_traits::destroy(allocator_, n);
+        allocator_traits::deallocate(allocator_, n, 1);
+    }
+
     void
     reset()
     {
-        buckets_ = {};
+        table_ = {};
+        old_ = {};
+        migrated_ = 0;
         size_ = 0;
     }
 
-    gem::detail::node<value_type>*&
-    bucket(const std::string& key) const
+    // Moves all entries into a bucket array of the given size in one pass
+    void
+    rehash(const std::size_t buckets)
     {
-        return buckets_[index(key)];
+        bucket_array table{buckets};
+        for (const auto t : {&old_, &table_})
+        {
+            for (std::size_t i = 0; i < t->size(); ++i)
+            {
+                auto n = t->buckets[i];
+                while (n)
+                {
+                    const auto next = n->next;
+                    auto& b = table.bucket(n->hash);
+                    n->next = b;
+                    b = n;
+                    n = next;
+                }
+            }
+        }
+        table_ = std::move(table);
+        old_ = {};
+        migrated_ = 0;
     }
 
-    static constexpr std::size_t buckets_minus_one = Buckets - 1;
+    void
+    grow()
+    {
+        old_ = std::move(table_);
+        table_ = bucket_array{old_.size() * 2};
+        migrated_ = 0;
+    }
 
-    std::size_t
-    index(const std::string& key) const
+    // Moves the next few chains of the old bucket array into the new one
+    void
+    migrate()
     {
-        return std::hash<std::string>{}(key)&buckets_minus_one;
+        if (!old_.buckets)
+        {
+            return;
+        }
+        const auto end = std::min(migrated_ + migration_step, old_.size());
+        for (; migrated_ < end; ++migrated_)
+        {
+            auto n = old_.buckets[migrated_];
+            old_.buckets[migrated_] = nullptr;
+            while (n)
+            {
+                const auto next = n->next;
+                auto& b = table_.bucket(n->hash);
+                n->next = b;
+                b = n;
+                n = next;
+            }
+        }
+        if (migrated_ == old_.size())
+        {
+            old_ = {};
+            migrated_ = 0;
+        }
     }
 
+    node_type*
+    find(const lookup_type& key, const std::size_t h) const
+    {
+        if (!table_.buckets)
+        {
+            return nullptr;
+        }
+        // migrated buckets of the old array are empty
+        for (const auto table : {&table_, &old_})
+        {
+            if (table->buckets)
+            {
+                for (auto n = table->bucket(h); n; n = n->next)
+                {
+                    if (n->hash == h && n->name() == key)
+                    {
+                        return n;
+                    }
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    static node_type*
+    unlink(const bucket_array& table,
+           const std::size_t h,
+           const lookup_type& key)
+    {
+        if (!table.buckets)
+        {
+            return nullptr;
+        }
+        for (auto link = &table.bucket(h); *link; link = &(*link)->next)
+        {
+            if ((*link)->hash == h && (*link)->name() == key)
+            {
+                const auto n = *link;
+                *link = n->next;
+                return n;
+            }
+        }
+        return nullptr;
+    }
+
+    Hash hash_;
+    node_allocator allocator_;
     std::optional<value_type> empty_;
-    mutable std::array<gem::detail::node<value_type>*, Buckets> buckets_ = {};
+    bucket_array table_;
+    bucket_array old_;
+    std::size_t migrated_ = 0;
     std::size_t size_ = 0;
+    mutable gem::detail::hashmap_counters<Counters> counters_;
 };
 
+// A gem::hashmap with the key type first, so that maps with keys other than
+// std::string need not restate the defaults of the other parameters
+template <typename Key,
+          typename ValueType,
+          std::size_t Buckets = 16,
+          typename Storage = gem::plain_storage,
+          typename Hash = gem::hash,
+          typename Allocator = std::allocator<ValueType>,
+          bool Counters = false>
+using basic_hashmap =
+    hashmap<ValueType, Buckets, Storage, Hash, Allocator, Key, Counters>;
+
 } // namespace gem
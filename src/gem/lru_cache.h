@@ -0,0 +1,513 @@
+#pragma once
+#include "concurrent_hashmap.h"
+#include "hashmap.h"
+#include "spinlock.h"
+#include <array>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace gem
+{
+
+// The default weigher of gem::lru_cache which counts every entry as one
+struct unit_weight
+{
+    template <typename ValueType>
+    std::size_t
+    operator()(const ValueType&) const
+    {
+        return 1;
+    }
+};
+
+namespace detail
+{
+
+// An entry of an lru_cache, linked into the recency list by slot index
+template <typename Key, typename ValueType>
+struct lru_entry
+{
+    Key key;
+    std::optional<ValueType> value;
+    std::size_t hash = 0;
+    std::size_t weight = 0;
+    std::size_t prev = 0;
+    std::size_t next = 0;
+};
+
+} // namespace detail
+
+// A cache which holds at most capacity worth of entries where Weigher
+// determines the weight of a value. A gem::hashmap maps each key to a slot
+// of a deque of entries which are linked into a list from the most to the
+// least recently used. The entry owns the key, an index of std::string keys
+// only holds a std::string_view of it. get moves the entry to the front of
+// the list and a put exceeding the capacity evicts entries from the back,
+// passing each to the eviction callback. Slots of evicted entries are reused,
+// so neither a hit nor an eviction allocates. An entry heavier than the
+// capacity is evicted right after it was put. Not thread-safe, see
+// gem::concurrent_lru_cache.
+template <typename ValueType,
+          typename Weigher = gem::unit_weight,
+          typename Hash = gem::hash,
+          typename Key = std::string>
+class lru_cache
+{
+    // entries never move, so the index can refer to their keys
+    using index_key = std::conditional_t<std::is_same_v<Key, std::string>,
+                                         std::string_view,
+                                         Key>;
+    using index_type = gem::hashmap<std::size_t,
+                                    16,
+                                    gem::plain_storage,
+                                    Hash,
+                                    std::allocator<std::size_t>,
+                                    index_key>;
+
+public:
+    using key_type = Key;
+    using value_type = ValueType;
+    using lookup_type = typename index_type::lookup_type;
+    // Called with every evicted entry. Must not access the cache
+    using evict_callback = std::function<void(const key_type&, value_type&&)>;
+
+    explicit lru_cache(const std::size_t capacity,
+                       evict_callback on_evict = {},
+                       Weigher weigher = {})
+        : capacity_{capacity}
+        , on_evict_{std::move(on_evict)}
+        , weigher_{std::move(weigher)}
+    {
+    }
+
+    // The index of the copy is rebuilt since it refers to the keys of the
+    // copied entries
+    lru_cache(const lru_cache& other)
+        : capacity_{other.capacity_}
+        , on_evict_{other.on_evict_}
+        , weigher_{other.weigher_}
+        , entries_{other.entries_}
+        , head_{other.head_}
+        , tail_{other.tail_}
+        , free_{other.free_}
+        , weight_{other.weight_}
+    {
+        for (auto slot = head_; slot != npos; slot = entries_[slot].next)
+        {
+            const auto& e = entries_[slot];
+            index_.put_hashed(index_key(e.key), e.hash, slot);
+        }
+    }
+
+    lru_cache&
+    operator=(const lru_cache& other)
+    {
+        if (this != &other)
+        {
+            *this = lru_cache{other};
+        }
+        return *this;
+    }
+
+    // Moving keeps the entries in place, the source is left empty
+    lru_cache(lru_cache&& other)
+        : capacity_{other.capacity_}
+        , on_evict_{std::move(other.on_evict_)}
+        , weigher_{std::move(other.weigher_)}
+    {
+        move_from(std::move(other));
+    }
+
+    lru_cache&
+    operator=(lru_cache&& other)
+    {
+        if (this != &other)
+        {
+            capacity_ = other.capacity_;
+            on_evict_ = std::move(other.on_evict_);
+            weigher_ = std::move(other.weigher_);
+            move_from(std::move(other));
+        }
+        return *this;
+    }
+
+    std::size_t
+    size() const
+    {
+        return index_.size();
+    }
+
+    // Returns the sum of the weights of all entries
+    std::size_t
+    weight() const
+    {
+        return weight_;
+    }
+
+    std::size_t
+    capacity() const
+    {
+        return capacity_;
+    }
+
+    // Inserts or replaces the value of the given key, makes it the most
+    // recently used entry and evicts entries until the capacity is met.
+    // Returns the previous value, if any
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, lookup_type> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        const auto h = hash(key);
+        return put_hashed(std::forward<K>(key), h, std::forward<T>(value));
+    }
+
+    // Returns the hash of the given key, see the *_hashed functions
+    std::size_t
+    hash(const lookup_type& key) const
+    {
+        return index_.hash(key);
+    }
+
+    // Same as put() where h must be hash(key)
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, lookup_type> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put_hashed(K&& key, const std::size_t h, T&& value)
+    {
+        const auto weight = weigher_(value);
+        std::optional<value_type> old_value;
+        if (const auto& existing = index_.get_hashed(key, h))
+        {
+            auto& e = entries_[*existing];
+            old_value = std::move(e.value);
+            e.value = std::forward<T>(value);
+            weight_ = weight_ - e.weight + weight;
+            e.weight = weight;
+            unlink(*existing);
+            link_front(*existing);
+        }
+        else
+        {
+            const auto slot = acquire();
+            auto& e = entries_[slot];
+            e.key = key_type(std::forward<K>(key));
+            e.value = std::forward<T>(value);
+            e.hash = h;
+            e.weight = weight;
+            weight_ += weight;
+            index_.put_hashed(index_key(e.key), h, slot);
+            link_front(slot);
+        }
+        evict();
+        return old_value;
+    }
+
+    // Returns the value of the given key and makes it the most recently used
+    // entry
+    const std::optional<value_type>&
+    get(const lookup_type& key)
+    {
+        return get_hashed(key, hash(key));
+    }
+
+    // Same as get() where h must be hash(key)
+    const std::optional<value_type>&
+    get_hashed(const lookup_type& key, const std::size_t h)
+    {
+        const auto& slot = index_.get_hashed(key, h);
+        if (!slot)
+        {
+            return empty_;
+        }
+        if (head_ != *slot)
+        {
+            unlink(*slot);
+            link_front(*slot);
+        }
+        return entries_[*slot].value;
+    }
+
+    // Returns the value of the given key without touching its recency
+    const std::optional<value_type>&
+    peek(const lookup_type& key) const
+    {
+        const auto& slot = index_.get(key);
+        return slot ? entries_[*slot].value : empty_;
+    }
+
+    // Removes the given key without calling the eviction callback
+    std::optional<value_type>
+    remove(const lookup_type& key)
+    {
+        return remove_hashed(key, hash(key));
+    }
+
+    // Same as remove() where h must be hash(key)
+    std::optional<value_type>
+    remove_hashed(const lookup_type& key, const std::size_t h)
+    {
+        const auto slot = index_.remove_hashed(key, h);
+        if (!slot)
+        {
+            return {};
+        }
+        unlink(*slot);
+        return release(*slot);
+    }
+
+private:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    void
+    move_from(lru_cache&& other)
+    {
+        index_ = std::move(other.index_);
+        entries_ = std::move(other.entries_);
+        head_ = std::exchange(other.head_, npos);
+        tail_ = std::exchange(other.tail_, npos);
+        free_ = std::exchange(other.free_, npos);
+        weight_ = std::exchange(other.weight_, 0);
+        other.index_ = index_type{};
+        other.entries_.clear();
+    }
+
+    // Returns a free slot, reusing the slot of an evicted entry if possible
+    std::size_t
+    acquire()
+    {
+        if (free_ != npos)
+        {
+            const auto slot = free_;
+            free_ = entries_[slot].next;
+            return slot;
+        }
+        entries_.emplace_back();
+        return entries_.size() - 1;
+    }
+
+    // Takes the value out of the unlinked slot and puts the slot on the free
+    // list
+    std::optional<value_type>
+    release(const std::size_t slot)
+    {
+        auto& e = entries_[slot];
+        auto value = std::move(e.value);
+        e.value.reset();
+        e.key = key_type{};
+        weight_ -= e.weight;
+        e.next = free_;
+        free_ = slot;
+        return value;
+    }
+
+    void
+    evict()
+    {
+        while (weight_ > capacity_ && tail_ != npos)
+        {
+            const auto slot = tail_;
+            unlink(slot);
+            auto& e = entries_[slot];
+            index_.remove_hashed(e.key, e.hash);
+            if (on_evict_)
+            {
+                on_evict_(e.key, std::move(*e.value));
+            }
+            release(slot);
+        }
+    }
+
+    void
+    link_front(const std::size_t slot)
+    {
+        auto& e = entries_[slot];
+        e.prev = npos;
+        e.next = head_;
+        if (head_ != npos)
+        {
+            entries_[head_].prev = slot;
+        }
+        else
+        {
+            tail_ = slot;
+        }
+        head_ = slot;
+    }
+
+    void
+    unlink(const std::size_t slot)
+    {
+        const auto& e = entries_[slot];
+        (e.prev != npos ? entries_[e.prev].next : head_) = e.next;
+        (e.next != npos ? entries_[e.next].prev : tail_) = e.prev;
+    }
+
+    std::size_t capacity_;
+    evict_callback on_evict_;
+    Weigher weigher_;
+    index_type index_;
+    std::deque<gem::detail::lru_entry<key_type, value_type>> entries_;
+    std::optional<value_type> empty_;
+    std::size_t head_ = npos;
+    std::size_t tail_ = npos;
+    std::size_t free_ = npos;
+    std::size_t weight_ = 0;
+};
+
+// A thread-safe lru_cache with string keys which is split into Shards
+// independent caches, each guarded by its own Mutex and holding an equal
+// share of the capacity. A capacity below Shards uses only as many shards
+// (rounded down to a power of 2) so that no shard has a capacity of zero.
+// Recency is tracked per shard. The eviction callback is called under the
+// shard's lock. All functions return copies of values.
+template <typename ValueType,
+          std::size_t Shards = 16,
+          typename Mutex = gem::spinlock,
+          typename Weigher = gem::unit_weight>
+class concurrent_lru_cache
+{
+public:
+    static_assert(Shards > 0 && !(Shards & (Shards - 1)),
+                  "Shards must be a power of 2");
+
+    using value_type = ValueType;
+    using cache_type = gem::lru_cache<value_type, Weigher>;
+    using evict_callback = typename cache_type::evict_callback;
+
+    explicit concurrent_lru_cache(const std::size_t capacity,
+                                  const evict_callback& on_evict = {},
+                                  const Weigher& weigher = {})
+        : shards_{make_shards(capacity, on_evict, weigher,
+                              std::make_index_sequence<Shards>{})}
+        , mask_{active_shards(capacity) - 1}
+    {
+    }
+
+    // delete copy/move semantics
+    concurrent_lru_cache(const concurrent_lru_cache&) = delete;
+    concurrent_lru_cache& operator=(const concurrent_lru_cache&) = delete;
+    concurrent_lru_cache(concurrent_lru_cache&&) = delete;
+    concurrent_lru_cache& operator=(concurrent_lru_cache&&) = delete;
+
+    // Returns the number of entries. The result is only a snapshot if other
+    // threads modify the cache concurrently
+    std::size_t
+    size() const
+    {
+        std::size_t size = 0;
+        for (const auto& s : shards_)
+        {
+            std::lock_guard lock{s.mutex};
+            size += s.cache.size();
+        }
+        return size;
+    }
+
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        const auto h = hash(key);
+        auto& s = shard(h);
+        std::lock_guard lock{s.mutex};
+        return s.cache.put_hashed(
+            std::forward<K>(key), h, std::forward<T>(value));
+    }
+
+    std::optional<value_type>
+    get(const std::string_view key)
+    {
+        const auto h = hash(key);
+        auto& s = shard(h);
+        std::lock_guard lock{s.mutex};
+        return s.cache.get_hashed(key, h);
+    }
+
+    std::optional<value_type>
+    remove(const std::string_view key)
+    {
+        const auto h = hash(key);
+        auto& s = shard(h);
+        std::lock_guard lock{s.mutex};
+        return s.cache.remove_hashed(key, h);
+    }
+
+private:
+    // shards live on separate cache lines to avoid false sharing
+    struct alignas(64) shard_type
+    {
+        shard_type(const std::size_t capacity,
+                   const evict_callback& on_evict,
+                   const Weigher& weigher)
+            : cache{capacity, on_evict, weigher}
+        {
+        }
+
+        mutable Mutex mutex;
+        cache_type cache;
+    };
+
+    // Returns the number of shards in use, the largest power of 2 not above
+    // Shards and the capacity
+    static constexpr std::size_t
+    active_shards(const std::size_t capacity)
+    {
+        std::size_t count = Shards;
+        while (count > 1 && count > capacity)
+        {
+            count >>= 1;
+        }
+        return count;
+    }
+
+    template <std::size_t... I>
+    static std::array<shard_type, Shards>
+    make_shards(const std::size_t capacity,
+                const evict_callback& on_evict,
+                const Weigher& weigher,
+                std::index_sequence<I...>)
+    {
+        // the first shards take the remainder of the capacity, unused shards
+        // get none
+        const auto count = active_shards(capacity);
+        return {{shard_type{I < count ? capacity / count +
+                                    (I < capacity % count)
+                                      : 0,
+                            on_evict,
+                            weigher}...}};
+    }
+
+    static std::size_t
+    hash(const std::string_view key)
+    {
+        return gem::hash{}(key);
+    }
+
+    shard_type&
+    shard(const std::size_t hash)
+    {
+        return shards_[gem::detail::shard_index<Shards>(hash) & mask_];
+    }
+
+    std::array<shard_type, Shards> shards_;
+    std::size_t mask_;
+};
+
+} // namespace gem
@@ -0,0 +1,611 @@
+#pragma once
+#include "hash.h"
+#include "hashmap.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gem
+{
+
+class mapped_error : public std::runtime_error
+{
+public:
+    explicit mapped_error(const std::string& message)
+        : std::runtime_error{message}
+    {
+    }
+};
+
+namespace detail
+{
+
+// Renames from to to, replacing to if it exists. Returns whether it
+// succeeded
+inline bool
+replace_file(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    // std::rename fails on Windows if the destination exists
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) !=
+        0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// A new file with a unique name next to a target file which replaces the
+// target once it is complete. Writes are buffered and the data is synced to
+// disk before the rename, so the target is never replaced by a partial file.
+// The file is removed unless commit() succeeded
+class temp_file
+{
+public:
+    explicit temp_file(const std::string& target)
+    {
+        std::random_device random;
+        for (int attempt = 0;; ++attempt)
+        {
+            path_ = target + ".tmp." + std::to_string(process_id()) + "." +
+                std::to_string(random());
+#ifdef _WIN32
+            handle_ = CreateFileA(path_.c_str(),
+                                  GENERIC_WRITE,
+                                  0,
+                                  nullptr,
+                                  CREATE_NEW,
+                                  FILE_ATTRIBUTE_NORMAL,
+                                  nullptr);
+            if (handle_ != INVALID_HANDLE_VALUE)
+            {
+                return;
+            }
+            const auto exists = GetLastError() == ERROR_FILE_EXISTS;
+#else
+            fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+            if (fd_ >= 0)
+            {
+                return;
+            }
+            const auto exists = errno == EEXIST;
+#endif
+            if (!exists || attempt == max_attempts)
+            {
+                throw gem::mapped_error{"Unable to create " + path_};
+            }
+        }
+    }
+
+    ~temp_file()
+    {
+        close();
+        if (!committed_)
+        {
+            std::remove(path_.c_str());
+        }
+    }
+
+    // delete copy semantics
+    temp_file(const temp_file&) = delete;
+    temp_file& operator=(const temp_file&) = delete;
+
+    void
+    write(const void* data, const std::size_t size)
+    {
+        const auto bytes = static_cast<const char*>(data);
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+        if (buffer_.size() >= buffer_size)
+        {
+            flush();
+        }
+    }
+
+    // Syncs the file to disk and renames it to the target
+    void
+    commit(const std::string& target)
+    {
+        flush();
+#ifdef _WIN32
+        const auto synced = FlushFileBuffers(handle_) != 0;
+#else
+        const auto synced = ::fsync(fd_) == 0;
+#endif
+        if (!synced || !close())
+        {
+            throw gem::mapped_error{"Unable to write " + path_};
+        }
+        if (!replace_file(path_, target))
+        {
+            throw gem::mapped_error{"Unable to replace " + target};
+        }
+        committed_ = true;
+    }
+
+private:
+    static constexpr int max_attempts = 100;
+    static constexpr std::size_t buffer_size = std::size_t{1} << 20;
+
+    static unsigned long
+    process_id()
+    {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return static_cast<unsigned long>(::getpid());
+#endif
+    }
+
+    void
+    flush()
+    {
+        std::size_t offset = 0;
+        while (offset < buffer_.size())
+        {
+#ifdef _WIN32
+            const auto chunk = static_cast<DWORD>(
+                std::min<std::size_t>(buffer_.size() - offset, 1u << 30));
+            DWORD written = 0;
+            if (!WriteFile(
+                    handle_, buffer_.data() + offset, chunk, &written, nullptr))
+            {
+                throw gem::mapped_error{"Unable to write " + path_};
+            }
+#else
+            const auto written = ::write(
+                fd_, buffer_.data() + offset, buffer_.size() - offset);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw gem::mapped_error{"Unable to write " + path_};
+            }
+#endif
+            offset += static_cast<std::size_t>(written);
+        }
+        buffer_.clear();
+    }
+
+    // Closes the file if it is open and returns whether that succeeded
+    bool
+    close()
+    {
+#ifdef _WIN32
+        if (handle_ == INVALID_HANDLE_VALUE)
+        {
+            return true;
+        }
+        const auto closed = CloseHandle(handle_) != 0;
+        handle_ = INVALID_HANDLE_VALUE;
+#else
+        if (fd_ < 0)
+        {
+            return true;
+        }
+        const auto closed = ::close(fd_) == 0;
+        fd_ = -1;
+#endif
+        return closed;
+    }
+
+    std::string path_;
+    std::vector<char> buffer_;
+#ifdef _WIN32
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+    bool committed_ = false;
+};
+
+// A read-only mapping of a whole file
+class file_mapping
+{
+public:
+    explicit file_mapping(const std::string& path)
+    {
+#ifdef _WIN32
+        const auto file = CreateFileA(path.c_str(),
+                                      GENERIC_READ,
+                                      FILE_SHARE_READ,
+                                      nullptr,
+                                      OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL,
+                                      nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw gem::mapped_error{"Unable to open " + path};
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            CloseHandle(file);
+            throw gem::mapped_error{"Unable to stat " + path};
+        }
+        size_ = static_cast<std::size_t>(size.QuadPart);
+        if (size_ > 0)
+        {
+            const auto mapping =
+                CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping)
+            {
+                data_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw gem::mapped_error{"Unable to open " + path};
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw gem::mapped_error{"Unable to stat " + path};
+        }
+        size_ = static_cast<std::size_t>(info.st_size);
+        if (size_ > 0)
+        {
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (data_ == MAP_FAILED)
+            {
+                data_ = nullptr;
+            }
+        }
+        // the mapping stays valid after closing the file
+        ::close(fd);
+#endif
+        if (!data_)
+        {
+            throw gem::mapped_error{"Unable to map " + path};
+        }
+    }
+
+    ~file_mapping()
+    {
+        if (data_)
+        {
+#ifdef _WIN32
+            UnmapViewOfFile(data_);
+#else
+            ::munmap(data_, size_);
+#endif
+        }
+    }
+
+    file_mapping(file_mapping&& other) noexcept
+        : data_{other.data_}
+        , size_{other.size_}
+    {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    file_mapping&
+    operator=(file_mapping&& other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+
+    // delete copy semantics
+    file_mapping(const file_mapping&) = delete;
+    file_mapping& operator=(const file_mapping&) = delete;
+
+    const unsigned char*
+    data() const
+    {
+        return static_cast<const unsigned char*>(data_);
+    }
+
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+
+private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// The file layout of a mapped_hashmap. All positions are byte offsets from
+// the start of the file, so the file can be mapped at any address. The
+// header is followed by bucket_count + 1 entry indices, the entries sorted
+// by bucket and a blob holding the keys and values
+struct mapped_header
+{
+    char magic[8];
+    std::uint64_t value_size; // zero for std::string values
+    std::uint64_t size;
+    std::uint64_t bucket_count;
+    std::uint64_t buckets;
+    std::uint64_t entries;
+};
+
+struct mapped_entry
+{
+    std::uint64_t hash;
+    std::uint64_t key;
+    std::uint64_t value;
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+};
+
+constexpr char mapped_magic[8] = {'g', 'e', 'm', 'm', 'a', 'p', '0', '1'};
+
+} // namespace detail
+
+// A read-only hash map with string keys that lives in a file. write() stores
+// the entries of any map with string keys, the constructor maps the file into
+// memory without reading or rebuilding anything, so pages are loaded on demand
+// and shared with every other process mapping the same file. Values are
+// either trivially copyable and returned by value or std::string and
+// returned as std::string_view into the mapping. The file has the byte order
+// of the machine that wrote it, and Hash must hash identically in every
+// process. The header is validated when the file is mapped and get() checks
+// every range and offset it follows against the file, throwing
+// gem::mapped_error instead of reading past the mapping of a corrupt file.
+template <typename ValueType, typename Hash = gem::hash>
+class mapped_hashmap
+{
+public:
+    static constexpr bool is_string = std::is_same_v<ValueType, std::string>;
+
+    static_assert(is_string || std::is_trivially_copyable_v<ValueType>,
+                  "ValueType must be std::string or trivially copyable");
+    static_assert(is_string || std::is_default_constructible_v<ValueType>,
+                  "ValueType must be default constructible");
+
+    using value_type = ValueType;
+    using get_type = std::conditional_t<is_string, std::string_view, ValueType>;
+
+    explicit mapped_hashmap(const std::string& path)
+        : mapping_{path}
+    {
+        using gem::detail::mapped_entry;
+        using gem::detail::mapped_header;
+        if (mapping_.size() < sizeof(mapped_header))
+        {
+            throw gem::mapped_error{"File too small: " + path};
+        }
+        std::memcpy(&header_, mapping_.data(), sizeof(mapped_header));
+        if (std::memcmp(header_.magic,
+                        gem::detail::mapped_magic,
+                        sizeof(header_.magic)) != 0)
+        {
+            throw gem::mapped_error{"Not a mapped_hashmap: " + path};
+        }
+        if (header_.value_size != value_size)
+        {
+            throw gem::mapped_error{"ValueType does not match: " + path};
+        }
+        const auto bucket_count = header_.bucket_count;
+        const auto file_size = mapping_.size();
+        if (bucket_count == 0 || (bucket_count & (bucket_count - 1)) != 0 ||
+            header_.buckets > file_size ||
+            (file_size - header_.buckets) / sizeof(std::uint64_t) <=
+                bucket_count ||
+            header_.entries > file_size ||
+            (file_size - header_.entries) / sizeof(mapped_entry) <
+                header_.size)
+        {
+            throw gem::mapped_error{"Corrupt mapped_hashmap: " + path};
+        }
+        mask_ = static_cast<std::size_t>(bucket_count - 1);
+    }
+
+    // Writes the entries of the given map to the file at path. They go to a
+    // uniquely named file next to it which is synced to disk and then
+    // atomically replaces the file, so concurrent writers do not interfere
+    // and processes still mapping the old file keep seeing the old entries
+    template <typename Map>
+    static void
+    write(const std::string& path, const Map& map)
+    {
+        using gem::detail::mapped_entry;
+        using gem::detail::mapped_header;
+        std::vector<mapped_entry> entries;
+        std::vector<std::string_view> keys;
+        std::vector<const value_type*> values;
+        for (const auto& [key, value] : map)
+        {
+            keys.emplace_back(key);
+            values.push_back(&value);
+        }
+        const auto bucket_count =
+            gem::detail::next_power_of_2(std::max<std::size_t>(keys.size(), 1));
+        const auto mask = bucket_count - 1;
+
+        // counting sort of the entries by bucket
+        std::vector<std::uint64_t> buckets(bucket_count + 1, 0);
+        std::vector<std::size_t> hashes(keys.size());
+        Hash hash;
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            hashes[i] = hash(keys[i]);
+            buckets[(hashes[i] & mask) + 1]++;
+        }
+        for (std::size_t b = 0; b < bucket_count; ++b)
+        {
+            buckets[b + 1] += buckets[b];
+        }
+        std::vector<std::size_t> order(keys.size());
+        {
+            auto next = buckets;
+            for (std::size_t i = 0; i < keys.size(); ++i)
+            {
+                order[next[hashes[i] & mask]++] = i;
+            }
+        }
+
+        mapped_header header{};
+        std::memcpy(header.magic,
+                    gem::detail::mapped_magic,
+                    sizeof(header.magic));
+        header.value_size = value_size;
+        header.size = keys.size();
+        header.bucket_count = bucket_count;
+        header.buckets = sizeof(mapped_header);
+        header.entries =
+            header.buckets + buckets.size() * sizeof(std::uint64_t);
+        auto blob = header.entries + keys.size() * sizeof(mapped_entry);
+        entries.reserve(keys.size());
+        for (const auto i : order)
+        {
+            mapped_entry entry{};
+            entry.hash = hashes[i];
+            entry.key = blob;
+            entry.key_size = size32(keys[i].size());
+            blob += entry.key_size;
+            entry.value = blob;
+            entry.value_size = size32(bytes(*values[i]).size());
+            blob += entry.value_size;
+            entries.push_back(entry);
+        }
+
+        gem::detail::temp_file file{path};
+        file.write(&header, sizeof(header));
+        file.write(buckets.data(), buckets.size() * sizeof(std::uint64_t));
+        file.write(entries.data(), entries.size() * sizeof(mapped_entry));
+        for (const auto i : order)
+        {
+            file.write(keys[i].data(), keys[i].size());
+            const auto value = bytes(*values[i]);
+            file.write(value.data(), value.size());
+        }
+        file.commit(path);
+    }
+
+    std::size_t
+    size() const
+    {
+        return static_cast<std::size_t>(header_.size);
+    }
+
+    std::size_t
+    bucket_count() const
+    {
+        return mask_ + 1;
+    }
+
+    std::optional<get_type>
+    get(const std::string_view key) const
+    {
+        const auto h = static_cast<std::uint64_t>(hash_(key));
+        const auto b = static_cast<std::size_t>(h) & mask_;
+        const auto base = mapping_.data();
+        std::uint64_t range[2];
+        std::memcpy(range,
+                    base + header_.buckets + b * sizeof(std::uint64_t),
+                    sizeof(range));
+        // the constructor checked that the bucket and entry arrays fit
+        if (range[0] > range[1] || range[1] > header_.size)
+        {
+            throw gem::mapped_error{"Corrupt bucket range"};
+        }
+        for (auto i = range[0]; i < range[1]; ++i)
+        {
+            gem::detail::mapped_entry entry;
+            std::memcpy(&entry,
+                        base + header_.entries +
+                            i * sizeof(gem::detail::mapped_entry),
+                        sizeof(entry));
+            if (entry.hash != h)
+            {
+                continue;
+            }
+            check_range(entry.key, entry.key_size);
+            if (key == std::string_view{reinterpret_cast<const char*>(
+                                            base + entry.key),
+                                        entry.key_size})
+            {
+                if constexpr (is_string)
+                {
+                    check_range(entry.value, entry.value_size);
+                    return std::string_view{
+                        reinterpret_cast<const char*>(base + entry.value),
+                        entry.value_size};
+                }
+                else
+                {
+                    check_range(entry.value, sizeof(value_type));
+                    value_type value;
+                    std::memcpy(&value, base + entry.value, sizeof(value));
+                    return value;
+                }
+            }
+        }
+        return {};
+    }
+
+private:
+    static constexpr std::uint64_t value_size =
+        is_string ? 0 : sizeof(ValueType);
+
+    // Throws unless size bytes at offset lie within the file
+    void
+    check_range(const std::uint64_t offset, const std::uint64_t size) const
+    {
+        const auto file_size = static_cast<std::uint64_t>(mapping_.size());
+        if (offset > file_size || size > file_size - offset)
+        {
+            throw gem::mapped_error{"Corrupt entry offset"};
+        }
+    }
+
+    static std::string_view
+    bytes(const value_type& value)
+    {
+        if constexpr (is_string)
+        {
+            return value;
+        }
+        else
+        {
+            return {reinterpret_cast<const char*>(&value), sizeof(value)};
+        }
+    }
+
+    static std::uint32_t
+    size32(const std::size_t size)
+    {
+        if (size > UINT32_MAX)
+        {
+            throw gem::mapped_error{"Key or value too large"};
+        }
+        return static_cast<std::uint32_t>(size);
+    }
+
+    gem::detail::file_mapping mapping_;
+    gem::detail::mapped_header header_;
+    std::size_t mask_;
+    Hash hash_;
+};
+
+} // namespace gem
@@ -0,0 +1,210 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace gem
+{
+
+// A lock-free bounded circular buffer (FIFO) with a capacity fixed at compile
+// time that is shared by any number of producer and consumer threads. Every
+// slot carries a sequence number which tells whether the slot is ready to be
+// written or read in the current lap around the buffer (D. Vyukov's bounded
+// MPMC queue), so producers and consumers only contend on their own position
+// counter and on the slot they claimed. Slots live on separate cache lines.
+// try_push fails when the buffer is full and try_pop fails when it is empty.
+// A value whose construction throws leaves its claimed slot behind, blocking
+// all consumers, so values should be nothrow constructible from what is
+// pushed.
+template <typename ValueType, std::size_t Capacity>
+class mpmc_circular_buffer
+{
+public:
+    static_assert(Capacity >= 2 && !(Capacity & (Capacity - 1)),
+                  "Capacity must be a power of 2 and at least 2");
+    static_assert(std::is_nothrow_destructible_v<ValueType>,
+                  "ValueType must be nothrow destructible");
+
+    using value_type = ValueType;
+    using size_type = std::size_t;
+
+    mpmc_circular_buffer() noexcept
+    {
+        for (size_type i = 0; i < Capacity; ++i)
+        {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~mpmc_circular_buffer()
+    {
+        const auto end = enqueue_pos_.load(std::memory_order_relaxed);
+        for (auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+             pos != end;
+             ++pos)
+        {
+            std::launder(
+                reinterpret_cast<value_type*>(&slots_[pos & mask].storage))
+                ->~value_type();
+        }
+    }
+
+    // delete copy/move semantics
+    mpmc_circular_buffer(const mpmc_circular_buffer&) = delete;
+    mpmc_circular_buffer& operator=(const mpmc_circular_buffer&) = delete;
+    mpmc_circular_buffer(mpmc_circular_buffer&&) = delete;
+    mpmc_circular_buffer& operator=(mpmc_circular_buffer&&) = delete;
+
+    // Pushes a new value onto the end of the buffer unless it is full
+    template <typename T,
+              typename =
+                  std::enable_if_t<std::is_same_v<std::decay_t<T>, value_type>>>
+    bool
+    try_push(T&& value)
+    {
+        return try_emplace(std::forward<T>(value));
+    }
+
+    // Constructs a new value at the end of the buffer unless it is full
+    template <typename... Args>
+    bool
+    try_emplace(Args&&... args)
+    {
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        if (claim(enqueue_pos_, pos, 1, 0) == 0)
+        {
+            return false;
+        }
+        auto& s = slots_[pos & mask];
+        new (&s.storage) value_type(std::forward<Args>(args)...);
+        s.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pushes up to count values read from first onto the end of the buffer
+    // by claiming their slots at once. Returns the number of values pushed
+    // which is less than count if the buffer fills up
+    template <typename InputIt>
+    size_type
+    try_push_n(InputIt first, const size_type count)
+    {
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        const auto claimed = claim(enqueue_pos_, pos, count, 0);
+        for (size_type i = 0; i < claimed; ++i, ++first)
+        {
+            auto& s = slots_[(pos + i) & mask];
+            new (&s.storage) value_type(*first);
+            s.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return claimed;
+    }
+
+    // Moves the value at the front of the buffer into the given value and
+    // removes it unless the buffer is empty
+    bool
+    try_pop(value_type& value)
+    {
+        return try_pop_n(&value, 1) == 1;
+    }
+
+    // Moves up to count values from the front of the buffer to out by
+    // claiming their slots at once. Returns the number of values popped
+    template <typename OutputIt>
+    size_type
+    try_pop_n(OutputIt out, const size_type count)
+    {
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+        const auto claimed = claim(dequeue_pos_, pos, count, 1);
+        for (size_type i = 0; i < claimed; ++i, ++out)
+        {
+            auto& s = slots_[(pos + i) & mask];
+            const auto value =
+                std::launder(reinterpret_cast<value_type*>(&s.storage));
+            *out = std::move(*value);
+            value->~value_type();
+            s.sequence.store(pos + i + Capacity, std::memory_order_release);
+        }
+        return claimed;
+    }
+
+    // Returns the capacity of the buffer
+    static constexpr size_type
+    capacity() noexcept
+    {
+        return Capacity;
+    }
+
+    // Returns the number of values in the buffer. The result is only a
+    // snapshot if other threads modify the buffer concurrently
+    size_type
+    size() const noexcept
+    {
+        const auto dequeue = dequeue_pos_.load(std::memory_order_acquire);
+        const auto enqueue = enqueue_pos_.load(std::memory_order_acquire);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+private:
+    static constexpr size_type mask = Capacity - 1;
+
+    // Claims up to count consecutive slots starting at the position counter
+    // whose sequence is their position plus offset, i.e. free slots for
+    // producers (offset 0) and full slots for consumers (offset 1). On
+    // success pos holds the first claimed position. Returns the number of
+    // claimed slots
+    size_type
+    claim(std::atomic<size_type>& counter,
+          size_type& pos,
+          const size_type count,
+          const size_type offset) noexcept
+    {
+        // nothing to claim, and a ready slot would otherwise look contended
+        if (count == 0)
+        {
+            return 0;
+        }
+        for (;;)
+        {
+            size_type ready = 0;
+            while (ready < count && ready < Capacity &&
+                   slots_[(pos + ready) & mask].sequence.load(
+                       std::memory_order_acquire) == pos + ready + offset)
+            {
+                ++ready;
+            }
+            if (ready == 0)
+            {
+                const auto sequence =
+                    slots_[pos & mask].sequence.load(std::memory_order_acquire);
+                // a slot of the previous lap means full or empty, anything
+                // else that another thread got ahead of us
+                if (static_cast<std::ptrdiff_t>(sequence - (pos + offset)) <
+                    0)
+                {
+                    return 0;
+                }
+                pos = counter.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (counter.compare_exchange_weak(
+                    pos, pos + ready, std::memory_order_relaxed))
+            {
+                return ready;
+            }
+        }
+    }
+
+    struct alignas(64) slot_type
+    {
+        std::atomic<size_type> sequence;
+        std::aligned_storage_t<sizeof(value_type), alignof(value_type)> storage;
+    };
+
+    alignas(64) std::atomic<size_type> enqueue_pos_{0};
+    alignas(64) std::atomic<size_type> dequeue_pos_{0};
+    slot_type slots_[Capacity];
+};
+
+} // namespace gem
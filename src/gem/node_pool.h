@@ -0,0 +1,243 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace gem
+{
+namespace detail
+{
+
+// Hands out blocks of one fixed size from contiguous slabs. Freed blocks are
+// recycled through an intrusive free list. The block size is fixed by the
+// first allocation
+class slab_arena
+{
+public:
+    explicit slab_arena(const std::size_t slab_blocks)
+        : slab_blocks_{slab_blocks}
+    {
+    }
+
+    ~slab_arena()
+    {
+        release();
+    }
+
+    // delete copy/move semantics
+    slab_arena(const slab_arena&) = delete;
+    slab_arena& operator=(const slab_arena&) = delete;
+    slab_arena(slab_arena&&) = delete;
+    slab_arena& operator=(slab_arena&&) = delete;
+
+    // Returns whether blocks of the given size and alignment are served
+    bool
+    serves(const std::size_t size, const std::size_t alignment)
+    {
+        if (!block_size_)
+        {
+            alignment_ = std::max(alignment, alignof(free_block));
+            block_size_ = round_up(std::max(size, sizeof(free_block)));
+        }
+        return block_size_ == round_up(std::max(size, sizeof(free_block))) &&
+            alignment <= alignment_;
+    }
+
+    void*
+    allocate()
+    {
+        if (free_)
+        {
+            const auto block = free_;
+            free_ = free_->next;
+            return block;
+        }
+        if (cursor_ == end_)
+        {
+            add_slab(slab_blocks_);
+        }
+        const auto block = cursor_;
+        cursor_ += block_size_;
+        return block;
+    }
+
+    void
+    deallocate(void* block) noexcept
+    {
+        free_ = new (block) free_block{free_};
+    }
+
+    // Makes sure the given number of blocks can be allocated without
+    // allocating another slab more than once
+    void
+    reserve(const std::size_t blocks)
+    {
+        if (!block_size_)
+        {
+            return;
+        }
+        const auto available =
+            static_cast<std::size_t>(end_ - cursor_) / block_size_;
+        if (blocks > available)
+        {
+            add_slab(blocks - available);
+        }
+    }
+
+    // Frees all slabs at once. All blocks handed out become invalid
+    void
+    release() noexcept
+    {
+        for (const auto slab : slabs_)
+        {
+            ::operator delete(slab, std::align_val_t{alignment_});
+        }
+        slabs_.clear();
+        cursor_ = end_ = nullptr;
+        free_ = nullptr;
+    }
+
+private:
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    std::size_t
+    round_up(const std::size_t size) const
+    {
+        return (size + alignment_ - 1) / alignment_ * alignment_;
+    }
+
+    void
+    add_slab(const std::size_t blocks)
+    {
+        // blocks left in the current slab are put on the free list
+        while (cursor_ != end_)
+        {
+            deallocate(cursor_);
+            cursor_ += block_size_;
+        }
+        const auto slab = static_cast<std::byte*>(::operator new(
+            blocks * block_size_, std::align_val_t{alignment_}));
+        slabs_.push_back(slab);
+        cursor_ = slab;
+        end_ = slab + blocks * block_size_;
+    }
+
+    std::size_t slab_blocks_;
+    std::size_t block_size_ = 0;
+    std::size_t alignment_ = 1;
+    std::vector<std::byte*> slabs_;
+    std::byte* cursor_ = nullptr;
+    std::byte* end_ = nullptr;
+    free_block* free_ = nullptr;
+};
+
+} // namespace detail
+
+// An allocator that serves single objects from slabs of SlabBlocks objects
+// and recycles freed objects through a free list. Copies and rebound copies
+// share the same slabs, whereas a container copy gets a pool of its own.
+// release() frees all slabs at once without visiting any object. Requests
+// for arrays or differently sized objects go to the global allocator.
+template <typename T, std::size_t SlabBlocks = 256>
+class node_pool
+{
+public:
+    static_assert(SlabBlocks > 0, "SlabBlocks must be larger than zero");
+
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = node_pool<U, SlabBlocks>;
+    };
+
+    node_pool()
+        : arena_{std::make_shared<gem::detail::slab_arena>(SlabBlocks)}
+    {
+    }
+
+    template <typename U>
+    node_pool(const node_pool<U, SlabBlocks>& other) noexcept
+        : arena_{other.arena_}
+    {
+    }
+
+    T*
+    allocate(const std::size_t n)
+    {
+        if (n == 1 && arena_->serves(sizeof(T), alignof(T)))
+        {
+            return static_cast<T*>(arena_->allocate());
+        }
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void
+    deallocate(T* ptr, const std::size_t n) noexcept
+    {
+        if (n == 1 && arena_->serves(sizeof(T), alignof(T)))
+        {
+            arena_->deallocate(ptr);
+        }
+        else
+        {
+            std::allocator<T>{}.deallocate(ptr, n);
+        }
+    }
+
+    node_pool
+    select_on_container_copy_construction() const
+    {
+        return {};
+    }
+
+    // Makes room for n objects in at most one new slab
+    void
+    reserve(const std::size_t n)
+    {
+        if (arena_->serves(sizeof(T), alignof(T)))
+        {
+            arena_->reserve(n);
+        }
+    }
+
+    // Frees all slabs at once. Objects are not destroyed
+    void
+    release() noexcept
+    {
+        arena_->release();
+    }
+
+    template <typename U>
+    bool
+    operator==(const node_pool<U, SlabBlocks>& other) const noexcept
+    {
+        return arena_ == other.arena_;
+    }
+
+    template <typename U>
+    bool
+    operator!=(const node_pool<U, SlabBlocks>& other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    template <typename U, std::size_t S>
+    friend class node_pool;
+
+    std::shared_ptr<gem::detail::slab_arena> arena_;
+};
+
+} // namespace gem
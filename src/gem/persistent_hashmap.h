@@ -0,0 +1,459 @@
+#pragma once
+#include "hash.h"
+#include <atomic>
+#include <bitset>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace gem
+{
+namespace detail
+{
+
+template <typename ValueType>
+struct persistent_leaf
+{
+    std::uint64_t owner;
+    std::string key;
+    std::size_t hash;
+    std::optional<ValueType> value;
+};
+
+// A node of a hash array mapped trie. Each level consumes five bits of the
+// hash: datamap marks the slots holding a leaf, nodemap the slots holding a
+// child node. Once all hash bits are consumed a node is a collision node
+// whose leaves are searched linearly. Only the map whose owner token the node
+// carries may modify it in place.
+template <typename ValueType>
+struct persistent_node
+{
+    using leaf_type = persistent_leaf<ValueType>;
+
+    std::uint64_t owner = 0;
+    std::uint32_t datamap = 0;
+    std::uint32_t nodemap = 0;
+    std::vector<std::shared_ptr<leaf_type>> leaves;
+    std::vector<std::shared_ptr<persistent_node>> children;
+};
+
+// Returns a new owner token for a persistent_hashmap
+inline std::uint64_t
+next_owner() noexcept
+{
+    static std::atomic<std::uint64_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+inline std::size_t
+popcount(const std::uint32_t value) noexcept
+{
+    return std::bitset<32>{value}.count();
+}
+
+} // namespace detail
+
+// A persistent hash map with string keys. Copying a map (e.g. through
+// snapshot()) is O(1) since the copy shares the whole trie. A later put or
+// remove copies the shared nodes on the path to the changed entry once, after
+// which the map owns the copies and modifies them in place. A snapshot
+// therefore stays a consistent read-only view while the original keeps being
+// modified. Different map objects sharing nodes may be used from different
+// threads; a single map object is not thread-safe except that any number of
+// threads may take snapshots of it while no thread modifies it.
+template <typename ValueType, typename Hash = gem::hash>
+class persistent_hashmap
+{
+public:
+    using value_type = ValueType;
+
+    persistent_hashmap() = default;
+
+    // Shares all nodes with the other map. The copy gets a fresh owner token
+    // and the other map's token is atomically replaced, so both give up
+    // ownership of the shared nodes. Nothing else of the other map changes
+    persistent_hashmap(const persistent_hashmap& other)
+        : hash_{other.hash_}
+        , root_{other.root_}
+        , size_{other.size_}
+    {
+        other.disown();
+    }
+
+    persistent_hashmap&
+    operator=(const persistent_hashmap& other)
+    {
+        if (this != &other)
+        {
+            hash_ = other.hash_;
+            root_ = other.root_;
+            size_ = other.size_;
+            disown();
+            other.disown();
+        }
+        return *this;
+    }
+
+    persistent_hashmap(persistent_hashmap&& other) noexcept
+        : hash_{std::move(other.hash_)}
+        , root_{std::move(other.root_)}
+        , size_{other.size_}
+        , owner_{other.owner_.load(std::memory_order_relaxed)}
+    {
+        other.size_ = 0;
+        other.disown();
+    }
+
+    persistent_hashmap&
+    operator=(persistent_hashmap&& other) noexcept
+    {
+        if (this != &other)
+        {
+            hash_ = std::move(other.hash_);
+            root_ = std::move(other.root_);
+            size_ = other.size_;
+            owner_.store(other.owner_.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+            other.size_ = 0;
+            other.disown();
+        }
+        return *this;
+    }
+
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+
+    // Returns an immutable view of the current state in O(1)
+    persistent_hashmap
+    snapshot() const
+    {
+        return *this;
+    }
+
+    // Inserts or replaces the value of the given key. A std::string key is
+    // only constructed if the key does not exist yet
+    template <typename K,
+              typename T,
+              typename = std::enable_if_t<
+                  std::is_convertible_v<const K&, std::string_view> &&
+                  std::is_same_v<std::decay_t<T>, value_type>>>
+    std::optional<value_type>
+    put(K&& key, T&& value)
+    {
+        const auto h = hash_(key);
+        own(root_);
+        auto old_value = insert(*root_,
+                                h,
+                                0,
+                                std::forward<K>(key),
+                                std::forward<T>(value));
+        if (!old_value)
+        {
+            size_++;
+        }
+        return old_value;
+    }
+
+    const std::optional<value_type>&
+    get(const std::string_view key) const
+    {
+        return find(key, hash_(key));
+    }
+
+    std::optional<value_type>
+    remove(const std::string_view key)
+    {
+        const auto h = hash_(key);
+        if (!find(key, h))
+        {
+            return {};
+        }
+        own(root_);
+        auto old_value = erase(*root_, h, 0, key);
+        size_--;
+        return old_value;
+    }
+
+    // Calls functor(key, value) for every entry
+    template <typename Functor>
+    void
+    for_each(Functor&& functor) const
+    {
+        if (root_)
+        {
+            visit(*root_, functor);
+        }
+    }
+
+private:
+    using leaf_type = gem::detail::persistent_leaf<value_type>;
+    using node_type = gem::detail::persistent_node<value_type>;
+
+    static constexpr std::size_t bits = 5;
+    static constexpr std::size_t hash_bits = sizeof(std::size_t) * CHAR_BIT;
+
+    static std::uint32_t
+    bit_of(const std::size_t hash, const std::size_t shift) noexcept
+    {
+        return std::uint32_t{1} << ((hash >> shift) & 0x1F);
+    }
+
+    // Returns the position of the slot of the given bit in its array
+    static std::size_t
+    index(const std::uint32_t map, const std::uint32_t bit) noexcept
+    {
+        return gem::detail::popcount(map & (bit - 1));
+    }
+
+    // Gives up ownership of all nodes by taking a new owner token. The token
+    // is atomic since concurrent snapshots of a const map replace it
+    void
+    disown() const noexcept
+    {
+        owner_.store(gem::detail::next_owner(), std::memory_order_relaxed);
+    }
+
+    // Makes sure this map owns the node by copying it if it does not. The
+    // copy shares the children of the original
+    template <typename T>
+    void
+    own(std::shared_ptr<T>& ptr)
+    {
+        const auto owner = owner_.load(std::memory_order_relaxed);
+        if (!ptr)
+        {
+            ptr = std::make_shared<T>();
+            ptr->owner = owner;
+        }
+        else if (ptr->owner != owner)
+        {
+            ptr = std::make_shared<T>(*ptr);
+            ptr->owner = owner;
+        }
+    }
+
+    template <typename K, typename T>
+    std::shared_ptr<leaf_type>
+    make_leaf(K&& key, const std::size_t hash, T&& value)
+    {
+        return std::make_shared<leaf_type>(
+            leaf_type{owner_.load(std::memory_order_relaxed),
+                      std::string(std::forward<K>(key)),
+                      hash,
+                      std::forward<T>(value)});
+    }
+
+    // Replaces the value of the leaf, copying the leaf if it is shared
+    template <typename T>
+    std::optional<value_type>
+    update(std::shared_ptr<leaf_type>& leaf, T&& value)
+    {
+        auto old_value = leaf->value;
+        own(leaf);
+        leaf->value = std::forward<T>(value);
+        return old_value;
+    }
+
+    template <typename K, typename T>
+    std::optional<value_type>
+    insert(node_type& node,
+           const std::size_t hash,
+           const std::size_t shift,
+           K&& key,
+           T&& value)
+    {
+        if (shift >= hash_bits)
+        {
+            for (auto& leaf : node.leaves)
+            {
+                if (leaf->hash == hash && leaf->key == key)
+                {
+                    return update(leaf, std::forward<T>(value));
+                }
+            }
+            node.leaves.push_back(make_leaf(
+                std::forward<K>(key), hash, std::forward<T>(value)));
+            return {};
+        }
+        const auto bit = bit_of(hash, shift);
+        if (node.nodemap & bit)
+        {
+            auto& child = node.children[index(node.nodemap, bit)];
+            own(child);
+            return insert(*child,
+                          hash,
+                          shift + bits,
+                          std::forward<K>(key),
+                          std::forward<T>(value));
+        }
+        if (node.datamap & bit)
+        {
+            const auto i = index(node.datamap, bit);
+            auto& existing = node.leaves[i];
+            if (existing->hash == hash && existing->key == key)
+            {
+                return update(existing, std::forward<T>(value));
+            }
+            // both leaves move one level down into a new child
+            std::shared_ptr<node_type> child;
+            own(child);
+            push_down(*child, existing, shift + bits);
+            insert(*child,
+                   hash,
+                   shift + bits,
+                   std::forward<K>(key),
+                   std::forward<T>(value));
+            node.leaves.erase(node.leaves.begin() +
+                              static_cast<std::ptrdiff_t>(i));
+            node.datamap &= ~bit;
+            node.nodemap |= bit;
+            node.children.insert(node.children.begin() +
+                                     static_cast<std::ptrdiff_t>(
+                                         index(node.nodemap, bit)),
+                                 std::move(child));
+            return {};
+        }
+        node.leaves.insert(
+            node.leaves.begin() +
+                static_cast<std::ptrdiff_t>(index(node.datamap, bit)),
+            make_leaf(std::forward<K>(key), hash, std::forward<T>(value)));
+        node.datamap |= bit;
+        return {};
+    }
+
+    // Inserts an existing (possibly shared) leaf into a new node
+    static void
+    push_down(node_type& node,
+              const std::shared_ptr<leaf_type>& leaf,
+              const std::size_t shift)
+    {
+        if (shift >= hash_bits)
+        {
+            node.leaves.push_back(leaf);
+            return;
+        }
+        const auto bit = bit_of(leaf->hash, shift);
+        node.datamap |= bit;
+        node.leaves.push_back(leaf);
+    }
+
+    // Returns the value of the key with the given hash or an empty optional
+    const std::optional<value_type>&
+    find(const std::string_view key, const std::size_t h) const
+    {
+        auto node = root_.get();
+        for (std::size_t shift = 0; node; shift += bits)
+        {
+            if (shift >= hash_bits)
+            {
+                for (const auto& leaf : node->leaves)
+                {
+                    if (leaf->hash == h && leaf->key == key)
+                    {
+                        return leaf->value;
+                    }
+                }
+                break;
+            }
+            const auto bit = bit_of(h, shift);
+            if (node->datamap & bit)
+            {
+                const auto& leaf = node->leaves[index(node->datamap, bit)];
+                if (leaf->hash == h && leaf->key == key)
+                {
+                    return leaf->value;
+                }
+                break;
+            }
+            if (!(node->nodemap & bit))
+            {
+                break;
+            }
+            node = node->children[index(node->nodemap, bit)].get();
+        }
+        return empty_;
+    }
+
+    // Removes the key which must exist in the trie below the node. A child
+    // left with a single leaf is inlined into its parent
+    std::optional<value_type>
+    erase(node_type& node,
+          const std::size_t hash,
+          const std::size_t shift,
+          const std::string_view key)
+    {
+        if (shift >= hash_bits)
+        {
+            for (auto it = node.leaves.begin(); it != node.leaves.end(); ++it)
+            {
+                if ((*it)->hash == hash && (*it)->key == key)
+                {
+                    auto old_value = (*it)->value;
+                    node.leaves.erase(it);
+                    return old_value;
+                }
+            }
+            return {};
+        }
+        const auto bit = bit_of(hash, shift);
+        if (node.datamap & bit)
+        {
+            const auto i = index(node.datamap, bit);
+            auto old_value = node.leaves[i]->value;
+            node.leaves.erase(node.leaves.begin() +
+                              static_cast<std::ptrdiff_t>(i));
+            node.datamap &= ~bit;
+            return old_value;
+        }
+        const auto i = index(node.nodemap, bit);
+        auto& child = node.children[i];
+        own(child);
+        auto old_value = erase(*child, hash, shift + bits, key);
+        if (child->children.empty() && child->leaves.size() <= 1)
+        {
+            if (child->leaves.size() == 1)
+            {
+                auto leaf = std::move(child->leaves.front());
+                node.leaves.insert(
+                    node.leaves.begin() +
+                        static_cast<std::ptrdiff_t>(index(node.datamap, bit)),
+                    std::move(leaf));
+                node.datamap |= bit;
+            }
+            node.children.erase(node.children.begin() +
+                                static_cast<std::ptrdiff_t>(i));
+            node.nodemap &= ~bit;
+        }
+        return old_value;
+    }
+
+    template <typename Functor>
+    static void
+    visit(const node_type& node, Functor& functor)
+    {
+        for (const auto& leaf : node.leaves)
+        {
+            functor(leaf->key, *leaf->value);
+        }
+        for (const auto& child : node.children)
+        {
+            visit(*child, functor);
+        }
+    }
+
+    Hash hash_;
+    std::optional<value_type> empty_;
+    std::shared_ptr<node_type> root_;
+    std::size_t size_ = 0;
+    mutable std::atomic<std::uint64_t> owner_{gem::detail::next_owner()};
+};
+
+} // namespace gem
@@ -0,0 +1,153 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace gem
+{
+
+// A wait-free circular buffer (FIFO) with a capacity fixed at compile time
+// that is shared by exactly one producer and one consumer thread. Unlike
+// gem::circular_buffer it never overwrites: try_push fails when the buffer is
+// full and try_pop fails when it is empty. The producer owns the tail and the
+// consumer the head, each on its own cache line together with a cached copy
+// of the other index, so the threads only touch each other's cache line when
+// the cached copy claims the buffer is full or empty.
+template <typename ValueType, std::size_t Capacity>
+class spsc_circular_buffer
+{
+public:
+    static_assert(Capacity >= 1, "Capacity must be at least 1");
+    static_assert(std::is_nothrow_destructible_v<ValueType>,
+                  "ValueType must be nothrow destructible");
+
+    using value_type = ValueType;
+    using size_type = std::size_t;
+
+    spsc_circular_buffer() = default;
+
+    ~spsc_circular_buffer()
+    {
+        auto head = head_.load(std::memory_order_relaxed);
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        while (head != tail)
+        {
+            slot(head)->~value_type();
+            head = next(head);
+        }
+    }
+
+    // delete copy/move semantics
+    spsc_circular_buffer(const spsc_circular_buffer&) = delete;
+    spsc_circular_buffer& operator=(const spsc_circular_buffer&) = delete;
+    spsc_circular_buffer(spsc_circular_buffer&&) = delete;
+    spsc_circular_buffer& operator=(spsc_circular_buffer&&) = delete;
+
+    // Pushes a new value onto the end of the buffer unless it is full.
+    // Producer only
+    template <typename T,
+              typename =
+                  std::enable_if_t<std::is_same_v<std::decay_t<T>, value_type>>>
+    bool
+    try_push(T&& value)
+    {
+        return try_emplace(std::forward<T>(value));
+    }
+
+    // Constructs a new value at the end of the buffer unless it is full.
+    // Producer only
+    template <typename... Args>
+    bool
+    try_emplace(Args&&... args)
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        const auto next_tail = next(tail);
+        if (next_tail == head_cache_)
+        {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (next_tail == head_cache_)
+            {
+                return false;
+            }
+        }
+        new (&slots_[tail]) value_type(std::forward<Args>(args)...);
+        tail_.store(next_tail, std::memory_order_release);
+        return true;
+    }
+
+    // Moves the value at the front of the buffer into the given value and
+    // removes it unless the buffer is empty. Consumer only
+    bool
+    try_pop(value_type& value)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_)
+        {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+            {
+                return false;
+            }
+        }
+        const auto front = slot(head);
+        value = std::move(*front);
+        front->~value_type();
+        head_.store(next(head), std::memory_order_release);
+        return true;
+    }
+
+    // Returns the capacity of the buffer
+    static constexpr size_type
+    capacity() noexcept
+    {
+        return Capacity;
+    }
+
+    // Returns the number of values in the buffer. The result is only a
+    // snapshot if the other thread modifies the buffer concurrently
+    size_type
+    size() const noexcept
+    {
+        const auto head = head_.load(std::memory_order_acquire);
+        const auto tail = tail_.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : slot_count - head + tail;
+    }
+
+    // Returns whether the buffer is empty. The result is only a snapshot if
+    // the other thread modifies the buffer concurrently
+    bool
+    empty() const noexcept
+    {
+        return head_.load(std::memory_order_acquire) ==
+            tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    // one slot stays free to tell a full from an empty buffer
+    static constexpr size_type slot_count = Capacity + 1;
+
+    static size_type
+    next(const size_type index) noexcept
+    {
+        return index == slot_count - 1 ? 0 : index + 1;
+    }
+
+    value_type*
+    slot(const size_type index) noexcept
+    {
+        return std::launder(reinterpret_cast<value_type*>(&slots_[index]));
+    }
+
+    // written by the producer
+    alignas(64) std::atomic<size_type> tail_{0};
+    size_type head_cache_{0};
+    // written by the consumer
+    alignas(64) std::atomic<size_type> head_{0};
+    size_type tail_cache_{0};
+    alignas(64) std::aligned_storage_t<sizeof(value_type), alignof(value_type)>
+        slots_[slot_count];
+};
+
+} // namespace gem
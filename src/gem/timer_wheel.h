@@ -0,0 +1,286 @@
+#pragma once
+#include "bits.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace gem
+{
+namespace detail
+{
+
+// A pending timer of a timer_wheel, linked into its slot by index
+template <typename ValueType>
+struct timer_node
+{
+    ValueType value;
+    std::uint64_t deadline;
+    std::size_t slot;
+    std::size_t prev;
+    std::size_t next;
+};
+
+} // namespace detail
+
+// A hierarchical timer wheel over integer ticks. Each level has 64 slots,
+// a slot of level n spanning 64^n ticks. A timer is put into the lowest level
+// whose slot tells its deadline apart from the current tick and moves down
+// a level whenever the wheel reaches its slot, so a timer is touched at most
+// once per level. advance() jumps straight to the next occupied slot, so its
+// cost depends on the number of expired timers and not on the number of
+// ticks passed or the number of pending timers. schedule() returns a handle
+// to cancel the timer, which stays valid until the timer expired or was
+// cancelled.
+template <typename ValueType>
+class timer_wheel
+{
+public:
+    using value_type = ValueType;
+    using handle = std::size_t;
+
+    explicit timer_wheel(const std::uint64_t now = 0)
+        : now_{now}
+    {
+        heads_.fill(npos);
+    }
+
+    timer_wheel(const timer_wheel&) = default;
+    timer_wheel& operator=(const timer_wheel&) = default;
+
+    // The source is left without timers at its current tick
+    timer_wheel(timer_wheel&& other) noexcept
+        : now_{other.now_}
+        , nodes_{std::move(other.nodes_)}
+        , heads_{other.heads_}
+        , occupied_{other.occupied_}
+        , free_{other.free_}
+        , size_{other.size_}
+    {
+        other.reset();
+    }
+
+    timer_wheel&
+    operator=(timer_wheel&& other) noexcept
+    {
+        if (this != &other)
+        {
+            now_ = other.now_;
+            nodes_ = std::move(other.nodes_);
+            heads_ = other.heads_;
+            occupied_ = other.occupied_;
+            free_ = other.free_;
+            size_ = other.size_;
+            other.reset();
+        }
+        return *this;
+    }
+
+    // Returns the number of pending timers
+    std::size_t
+    size() const
+    {
+        return size_;
+    }
+
+    // Returns the tick the wheel was last advanced to
+    std::uint64_t
+    now() const
+    {
+        return now_;
+    }
+
+    // Schedules the value to expire at the given tick. Deadlines in the past
+    // expire with the next advance()
+    template <typename T>
+    handle
+    schedule(const std::uint64_t deadline, T&& value)
+    {
+        handle h;
+        if (free_ != npos)
+        {
+            h = free_;
+            free_ = nodes_[h].next;
+            nodes_[h].value = std::forward<T>(value);
+        }
+        else
+        {
+            h = nodes_.size();
+            nodes_.push_back(node_type{std::forward<T>(value), 0, 0, 0, 0});
+        }
+        nodes_[h].deadline = std::max(deadline, now_);
+        link(h);
+        size_++;
+        return h;
+    }
+
+    // Cancels a pending timer and returns its value
+    value_type
+    cancel(const handle h)
+    {
+        unlink(h);
+        return release(h);
+    }
+
+    // Returns the value of a pending timer
+    value_type&
+    value(const handle h)
+    {
+        return nodes_[h].value;
+    }
+
+    // Returns the deadline of a pending timer
+    std::uint64_t
+    deadline(const handle h) const
+    {
+        return nodes_[h].deadline;
+    }
+
+    // Moves the wheel to the given tick and calls functor(value) for every
+    // timer whose deadline is not later, in order of deadline. The functor
+    // may schedule new timers but must not cancel any. Returns the number of
+    // expired timers
+    template <typename Functor>
+    std::size_t
+    advance(const std::uint64_t now, Functor&& functor)
+    {
+        std::size_t expired = 0;
+        while (size_)
+        {
+            const auto [level, slot, deadline] = next_slot();
+            if (deadline > now)
+            {
+                break;
+            }
+            now_ = std::max(now_, deadline);
+            auto h = heads_[level * slots + slot];
+            heads_[level * slots + slot] = npos;
+            occupied_[level] &= ~(std::uint64_t{1} << slot);
+            while (h != npos)
+            {
+                const auto next = nodes_[h].next;
+                if (nodes_[h].deadline <= now_)
+                {
+                    functor(release(h));
+                    expired++;
+                }
+                else
+                {
+                    // moves to a lower level
+                    link(h);
+                }
+                h = next;
+            }
+        }
+        now_ = std::max(now_, now);
+        return expired;
+    }
+
+private:
+    using node_type = gem::detail::timer_node<value_type>;
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    static constexpr std::size_t bits = 6;
+    static constexpr std::size_t slots = std::size_t{1} << bits;
+    static constexpr std::size_t levels = (64 + bits - 1) / bits;
+
+    struct slot_position
+    {
+        std::size_t level;
+        std::size_t slot;
+        std::uint64_t deadline;
+    };
+
+    // Returns the earliest occupied slot and the tick it becomes due. Slots
+    // of a lower level are always due before those of a higher level
+    slot_position
+    next_slot() const
+    {
+        for (std::size_t level = 0; level < levels; ++level)
+        {
+            if (occupied_[level])
+            {
+                const auto slot = gem::detail::lowest_bit(occupied_[level]);
+                const auto shift = level * bits;
+                const auto span = shift + bits;
+                const auto start =
+                    span >= 64 ? 0 : now_ & ~((std::uint64_t{1} << span) - 1);
+                return {level, slot, start + (std::uint64_t{slot} << shift)};
+            }
+        }
+        return {0, 0, UINT64_MAX};
+    }
+
+    void
+    link(const handle h)
+    {
+        auto& n = nodes_[h];
+        // the highest bit in which the deadline differs from now selects the
+        // level, the deadline's digit on that level the slot
+        const auto differ = (n.deadline ^ now_) | (slots - 1);
+        std::size_t high = 63;
+        while (!(differ >> high))
+        {
+            --high;
+        }
+        const auto level = high / bits;
+        const auto digit = n.deadline >> (level * bits);
+        const auto slot = static_cast<std::size_t>(digit) & (slots - 1);
+        n.slot = level * slots + slot;
+        n.prev = npos;
+        n.next = heads_[n.slot];
+        if (n.next != npos)
+        {
+            nodes_[n.next].prev = h;
+        }
+        heads_[n.slot] = h;
+        occupied_[level] |= std::uint64_t{1} << slot;
+    }
+
+    void
+    unlink(const handle h)
+    {
+        const auto& n = nodes_[h];
+        (n.prev != npos ? nodes_[n.prev].next : heads_[n.slot]) = n.next;
+        if (n.next != npos)
+        {
+            nodes_[n.next].prev = n.prev;
+        }
+        if (heads_[n.slot] == npos)
+        {
+            occupied_[n.slot / slots] &= ~(std::uint64_t{1} << n.slot % slots);
+        }
+    }
+
+    void
+    reset() noexcept
+    {
+        nodes_.clear();
+        heads_.fill(npos);
+        occupied_.fill(0);
+        free_ = npos;
+        size_ = 0;
+    }
+
+    // Takes the value out of the unlinked node and puts the node on the free
+    // list
+    value_type
+    release(const handle h)
+    {
+        auto value = std::move(nodes_[h].value);
+        nodes_[h].next = free_;
+        free_ = h;
+        size_--;
+        return value;
+    }
+
+    std::uint64_t now_;
+    std::vector<node_type> nodes_;
+    std::array<std::size_t, levels * slots> heads_;
+    std::array<std::uint64_t, levels> occupied_{};
+    std::size_t free_ = npos;
+    std::size_t size_ = 0;
+};
+
+} // namespace gem
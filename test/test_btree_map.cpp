@@ -0,0 +1,153 @@
+#include "catch.hpp"
+#include <gem/btree_map.h>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+template <typename Range>
+std::vector<std::string>
+keys_of(const Range& range)
+{
+    std::vector<std::string> keys;
+    for (const auto& [key, value] : range)
+    {
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+} // namespace
+
+TEST_CASE("btree_map__put_get_remove")
+{
+    gem::btree_map<int> map;
+    REQUIRE(0 == map.size());
+    REQUIRE(map.begin() == map.end());
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE_FALSE(map.put("foo", 42));
+    REQUIRE(42 == *map.get("foo"));
+    REQUIRE(42 == *map.put("foo", 43));
+    REQUIRE(43 == *map.get("foo"));
+    REQUIRE_FALSE(map.put("bar", 44));
+    REQUIRE(2 == map.size());
+    REQUIRE(43 == *map.remove("foo"));
+    REQUIRE_FALSE(map.remove("foo"));
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE(44 == *map.get("bar"));
+    REQUIRE(1 == map.size());
+}
+
+TEST_CASE("btree_map__reuse_moved_from")
+{
+    gem::btree_map<int, 4> map;
+    for (int i = 0; i < 100; ++i)
+    {
+        map.put(std::to_string(i), i);
+    }
+    auto other = std::move(map);
+    REQUIRE(100 == other.size());
+    REQUIRE(0 == map.size());
+    REQUIRE(map.begin() == map.end());
+    REQUIRE(map.lower_bound("5") == map.end());
+    REQUIRE_FALSE(map.get("5"));
+    REQUIRE_FALSE(map.put("foo", 42));
+    REQUIRE(42 == *map.get("foo"));
+    map = std::move(other);
+    REQUIRE(100 == map.size());
+    REQUIRE(5 == *map.get("5"));
+    REQUIRE(0 == other.size());
+    REQUIRE_FALSE(other.put("bar", 43));
+    REQUIRE(43 == *other.get("bar"));
+}
+
+TEST_CASE("btree_map__matches_std_map")
+{
+    gem::btree_map<int, 4> map;
+    std::map<std::string, int> expected;
+    std::mt19937 random{42};
+    for (int i = 0; i < 20000; ++i)
+    {
+        const auto key = std::to_string(random() % 2000);
+        if (random() % 3)
+        {
+            const auto value = static_cast<int>(random() % 100);
+            const auto it = expected.find(key);
+            const auto old_value = map.put(key, value);
+            REQUIRE(static_cast<bool>(old_value) == (it != expected.end()));
+            expected[key] = value;
+        }
+        else
+        {
+            const auto it = expected.find(key);
+            const auto old_value = map.remove(key);
+            REQUIRE(static_cast<bool>(old_value) == (it != expected.end()));
+            if (it != expected.end())
+            {
+                REQUIRE(it->second == *old_value);
+                expected.erase(it);
+            }
+        }
+    }
+    REQUIRE(expected.size() == map.size());
+    auto it = map.begin();
+    for (const auto& [key, value] : expected)
+    {
+        REQUIRE(it != map.end());
+        REQUIRE(key == (*it).first);
+        REQUIRE(value == (*it).second);
+        ++it;
+    }
+    REQUIRE(it == map.end());
+    for (const auto& [key, value] : expected)
+    {
+        REQUIRE(value == *map.remove(key));
+    }
+    REQUIRE(0 == map.size());
+    REQUIRE(map.begin() == map.end());
+}
+
+TEST_CASE("btree_map__lower_bound_and_range")
+{
+    gem::btree_map<int, 4> map;
+    for (int i = 10; i < 100; i += 2)
+    {
+        map.put(std::to_string(i), i);
+    }
+    REQUIRE("20" == (*map.lower_bound("20")).first);
+    REQUIRE("22" == (*map.lower_bound("21")).first);
+    REQUIRE("10" == (*map.lower_bound("")).first);
+    REQUIRE(map.lower_bound("99") == map.end());
+    REQUIRE(std::vector<std::string>{"20", "22", "24"} ==
+            keys_of(map.range("19", "26")));
+    REQUIRE(keys_of(map.range("30", "30")).empty());
+    REQUIRE(keys_of(map.range("40", "30")).empty());
+    REQUIRE(std::vector<std::string>{"96", "98"} ==
+            keys_of(map.range("95", "999")));
+}
+
+TEST_CASE("btree_map__prefix_scan")
+{
+    gem::btree_map<int> map;
+    map.put("metrics/cpu/user", 1);
+    map.put("metrics/cpu/system", 2);
+    map.put("metrics/cpu", 3);
+    map.put("metrics/cpu0", 4);
+    map.put("metrics/mem/free", 5);
+    map.put("metrics/cpv", 6);
+    const std::vector<std::string> cpu{"metrics/cpu/system",
+                                       "metrics/cpu/user"};
+    REQUIRE(cpu == keys_of(map.prefix_scan("metrics/cpu/")));
+    REQUIRE(4 == keys_of(map.prefix_scan("metrics/cpu")).size());
+    REQUIRE(6 == keys_of(map.prefix_scan("")).size());
+    REQUIRE(keys_of(map.prefix_scan("metrics/disk")).empty());
+    map.put(std::string{"\xff\xff"}, 7);
+    map.put(std::string{"\xff\xff\x01"}, 8);
+    map.put(std::string{"\xfe"}, 9);
+    REQUIRE(2 == keys_of(map.prefix_scan(std::string{"\xff"})).size());
+    REQUIRE(1 == keys_of(map.prefix_scan(std::string{"\xfe"})).size());
+}
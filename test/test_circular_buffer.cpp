@@ -1,5 +1,10 @@
 #include "catch.hpp"
 #include <gem/circular_buffer.h>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <vector>
 
 using gem::circular_buffer;
 
@@ -273,3 +278,249 @@ TEST_CASE("circular_buffer__front_non_const_overload")
     REQUIRE(42 == buffer1.front());
     REQUIRE(1 == buffer1.size());
 }
+
+TEST_CASE("circular_buffer__is_equal_with_different_fronts")
+{
+    circular_buffer<int, 3> buffer1;
+    buffer1.push(1);
+    buffer1.push(2);
+    circular_buffer<int, 3> buffer2;
+    buffer2.push(0);
+    buffer2.push(1);
+    buffer2.push(2);
+    buffer2.pop();
+    REQUIRE(buffer1 == buffer2);
+    buffer2.push(3);
+    buffer1.push(3);
+    REQUIRE(buffer1 == buffer2);
+}
+
+TEST_CASE("circular_buffer__power_of_2_capacity")
+{
+    // free-running indices need no separate size
+    static_assert(sizeof(circular_buffer<char, 4>) <
+                      sizeof(circular_buffer<char, 3>),
+                  "");
+    circular_buffer<int, 4> buffer;
+    for (int i = 0; i < 100; ++i)
+    {
+        buffer.push(i);
+        REQUIRE(static_cast<std::size_t>(std::min(i + 1, 4)) == buffer.size());
+        REQUIRE(std::max(0, i - 3) == buffer.front());
+    }
+    REQUIRE(buffer.full());
+    for (int i = 96; i < 100; ++i)
+    {
+        REQUIRE(i == buffer.front());
+        buffer.pop();
+    }
+    REQUIRE(buffer.empty());
+    buffer.pop();
+    REQUIRE(buffer.empty());
+    buffer.push(7);
+    REQUIRE(7 == buffer.front());
+    REQUIRE(1 == buffer.size());
+}
+
+namespace
+{
+
+// counts its live instances and has no default constructor
+struct tracked
+{
+    static int live;
+
+    explicit tracked(const int value)
+        : value{value}
+    {
+        live++;
+    }
+
+    tracked(const tracked& other)
+        : value{other.value}
+    {
+        live++;
+    }
+
+    tracked&
+    operator=(const tracked& other) = default;
+
+    ~tracked()
+    {
+        live--;
+    }
+
+    bool
+    operator==(const tracked& other) const
+    {
+        return value == other.value;
+    }
+
+    int value;
+};
+
+int tracked::live = 0;
+
+} // namespace
+
+TEST_CASE("circular_buffer__constructs_only_populated_values")
+{
+    {
+        circular_buffer<tracked, 3> buffer;
+        REQUIRE(0 == tracked::live);
+        REQUIRE(1 == buffer.emplace_back(1).value);
+        buffer.emplace_back(2);
+        buffer.emplace_back(3);
+        REQUIRE(3 == tracked::live);
+        buffer.emplace_back(4);
+        REQUIRE(3 == tracked::live);
+        REQUIRE(2 == buffer.front().value);
+        buffer.pop();
+        REQUIRE(2 == tracked::live);
+        auto copy = buffer;
+        REQUIRE(4 == tracked::live);
+        REQUIRE(copy == buffer);
+        buffer.clear();
+        REQUIRE(buffer.empty());
+        REQUIRE(2 == tracked::live);
+        buffer.push(tracked{5});
+        REQUIRE(3 == tracked::live);
+    }
+    REQUIRE(0 == tracked::live);
+}
+
+namespace
+{
+
+struct pinned
+{
+    explicit pinned(int value)
+        : value{value}
+    {
+    }
+
+    pinned(const pinned&) = delete;
+    pinned& operator=(const pinned&) = delete;
+
+    int value;
+};
+
+} // namespace
+
+TEST_CASE("circular_buffer__emplace_back_non_movable")
+{
+    circular_buffer<pinned, 2> buffer;
+    buffer.emplace_back(1);
+    buffer.emplace_back(2);
+    REQUIRE(3 == buffer.emplace_back(3).value);
+    REQUIRE(2 == buffer.size());
+    REQUIRE(2 == buffer.front().value);
+    buffer.pop();
+    REQUIRE(3 == buffer.front().value);
+}
+
+TEST_CASE("circular_buffer__push_front_into_full_buffer")
+{
+    circular_buffer<std::string, 2> buffer;
+    buffer.push(std::string(100, 'a'));
+    buffer.push(std::string(100, 'b'));
+    buffer.push(buffer.front());
+    REQUIRE(std::string(100, 'b') == buffer.front());
+    buffer.pop();
+    REQUIRE(std::string(100, 'a') == buffer.front());
+}
+
+TEST_CASE("circular_buffer__move_and_swap_non_trivial")
+{
+    circular_buffer<std::string, 4> buffer1;
+    buffer1.push(std::string{"a"});
+    buffer1.push(std::string{"b"});
+    buffer1.push(std::string{"c"});
+    circular_buffer<std::string, 4> buffer2;
+    buffer2.push(std::string{"x"});
+    std::swap(buffer1, buffer2);
+    REQUIRE(1 == buffer1.size());
+    REQUIRE("x" == buffer1.front());
+    REQUIRE(3 == buffer2.size());
+    REQUIRE("a" == buffer2.front());
+    auto moved = std::move(buffer2);
+    REQUIRE(3 == moved.size());
+    for (const auto expected : {"a", "b", "c"})
+    {
+        REQUIRE(expected == moved.front());
+        moved.pop();
+    }
+    moved = buffer1;
+    REQUIRE(moved == buffer1);
+}
+
+TEST_CASE("circular_buffer__push_range_and_array_ranges")
+{
+    circular_buffer<int, 8> buffer;
+    REQUIRE(nullptr == buffer.array_one().first);
+    REQUIRE(0 == buffer.array_one().second);
+    REQUIRE(0 == buffer.array_two().second);
+    const std::vector<int> values{1, 2, 3, 4, 5, 6};
+    buffer.push_range(values.begin(), values.end());
+    REQUIRE(6 == buffer.size());
+    REQUIRE(6 == buffer.array_one().second);
+    REQUIRE(0 == buffer.array_two().second);
+    REQUIRE(std::equal(values.begin(),
+                       values.end(),
+                       buffer.array_one().first));
+    // wraps around and drops the two oldest values
+    buffer.push_range(values.begin(), values.begin() + 4);
+    REQUIRE(buffer.full());
+    REQUIRE(3 == buffer.front());
+    const auto one = buffer.array_one();
+    const auto two = buffer.array_two();
+    REQUIRE(6 == one.second);
+    REQUIRE(2 == two.second);
+    std::vector<int> contents(one.first, one.first + one.second);
+    contents.insert(contents.end(), two.first, two.first + two.second);
+    REQUIRE(std::vector<int>{3, 4, 5, 6, 1, 2, 3, 4} == contents);
+    // keeps only the last Capacity values of a longer range
+    std::vector<int> many(20);
+    std::iota(many.begin(), many.end(), 0);
+    buffer.push_range(many.begin(), many.end());
+    REQUIRE(buffer.full());
+    REQUIRE(12 == buffer.front());
+}
+
+TEST_CASE("circular_buffer__pop_range")
+{
+    circular_buffer<std::string, 4> buffer;
+    const std::vector<std::string> values{"a", "b", "c", "d", "e"};
+    buffer.push_range(values.begin(), values.begin() + 3);
+    REQUIRE(1 == buffer.pop_range(1));
+    buffer.push_range(std::make_move_iterator(values.begin() + 3),
+                      std::make_move_iterator(values.end()));
+    REQUIRE(3 == buffer.array_one().second);
+    REQUIRE(1 == buffer.array_two().second);
+    REQUIRE("e" == *buffer.array_two().first);
+    std::vector<std::string> popped;
+    REQUIRE(4 == buffer.pop_range(std::back_inserter(popped), 10));
+    REQUIRE(std::vector<std::string>{"b", "c", "d", "e"} == popped);
+    REQUIRE(buffer.empty());
+    REQUIRE(0 == buffer.pop_range(1));
+    buffer.push(std::string{"f"});
+    REQUIRE("f" == buffer.front());
+}
+
+TEST_CASE("circular_buffer__ranges_destroy_values")
+{
+    {
+        circular_buffer<tracked, 3> buffer;
+        const std::vector<tracked> values{tracked{1}, tracked{2}, tracked{3}};
+        buffer.push_range(values.begin(), values.end());
+        buffer.push_range(values.begin(), values.begin() + 2);
+        REQUIRE(6 == tracked::live);
+        REQUIRE(3 == buffer.front().value);
+        std::vector<tracked> popped;
+        REQUIRE(2 == buffer.pop_range(std::back_inserter(popped), 2));
+        REQUIRE(3 == popped[0].value);
+        REQUIRE(1 == popped[1].value);
+        REQUIRE(6 == tracked::live);
+    }
+    REQUIRE(0 == tracked::live);
+}
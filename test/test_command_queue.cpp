@@ -1,5 +1,8 @@
 #include "catch.hpp"
 #include <gem/command_queue.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 using gem::command_queue;
 
@@ -27,3 +30,80 @@ TEST_CASE("command_queue__happy_path")
     REQUIRE(42 == foo.arg1);
     REQUIRE(13.0 == foo.arg2);
 }
+
+struct Counter
+{
+    int sum = 0;
+    void
+    add(int value)
+    {
+        sum += value;
+    }
+};
+
+TEST_CASE("command_queue__concurrent_push")
+{
+    command_queue<64, 1024> q;
+    Counter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&q, &counter] {
+            for (int i = 0; i < 100; ++i)
+            {
+                q.push(&counter, &Counter::add, 1);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    q.sync();
+    REQUIRE(400 == counter.sum);
+}
+
+struct Text
+{
+    std::string value;
+    void
+    set(std::string text)
+    {
+        value = std::move(text);
+    }
+};
+
+namespace
+{
+
+template <typename Queue>
+void
+push_text(Queue& q, Text& text, const char* value)
+{
+    // pushed from a deeper stack frame than the one calling sync
+    q.push(&text, &Text::set, std::string(value));
+}
+
+} // namespace
+
+TEST_CASE("command_queue__string_argument")
+{
+    command_queue q;
+    Text short_text;
+    Text long_text;
+    push_text(q, short_text, "short");
+    push_text(q, long_text, "a string too long for the small buffer");
+    q.sync();
+    REQUIRE("short" == short_text.value);
+    REQUIRE("a string too long for the small buffer" == long_text.value);
+}
+
+TEST_CASE("command_queue__destroys_unsynced_commands")
+{
+    Text text;
+    {
+        command_queue<64, 2> q;
+        push_text(q, text, "a string too long for the small buffer");
+    }
+    REQUIRE(text.value.empty());
+}
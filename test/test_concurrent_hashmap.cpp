@@ -0,0 +1,78 @@
+#include "catch.hpp"
+#include <gem/concurrent_hashmap.h>
+#include <thread>
+#include <vector>
+
+TEST_CASE("concurrent_hashmap__put_get_remove")
+{
+    gem::concurrent_hashmap<int> map;
+    REQUIRE(0 == map.size());
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE_FALSE(map.put("foo", 42));
+    REQUIRE(42 == *map.get("foo"));
+    REQUIRE(42 == *map.put("foo", 43));
+    REQUIRE_FALSE(map.put("bar", 44));
+    REQUIRE(2 == map.size());
+    REQUIRE(43 == *map.remove("foo"));
+    REQUIRE_FALSE(map.remove("foo"));
+    REQUIRE(1 == map.size());
+}
+
+TEST_CASE("concurrent_hashmap__put_if_absent")
+{
+    gem::concurrent_hashmap<int> map;
+    REQUIRE_FALSE(map.put_if_absent("foo", 42));
+    REQUIRE(42 == *map.put_if_absent("foo", 43));
+    REQUIRE(42 == *map.get("foo"));
+}
+
+TEST_CASE("concurrent_hashmap__compute")
+{
+    gem::concurrent_hashmap<int> map;
+    const auto increment = [](const std::optional<int>& value) {
+        return std::optional<int>{value ? *value + 1 : 1};
+    };
+    REQUIRE(1 == *map.compute("foo", increment));
+    REQUIRE(2 == *map.compute("foo", increment));
+    REQUIRE_FALSE(map.compute(
+        "foo", [](const std::optional<int>&) { return std::optional<int>{}; }));
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE(0 == map.size());
+}
+
+template <typename Mutex>
+void
+test_parallel_compute()
+{
+    gem::concurrent_hashmap<int, 4, Mutex> map;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&map] {
+            for (int i = 0; i < 1000; ++i)
+            {
+                map.compute(std::to_string(i % 100),
+                            [](const std::optional<int>& value) {
+                                return std::optional<int>{value ? *value + 1
+                                                                : 1};
+                            });
+                map.get(std::to_string(i % 50));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    REQUIRE(100 == map.size());
+    for (int i = 0; i < 100; ++i)
+    {
+        REQUIRE(40 == *map.get(std::to_string(i)));
+    }
+}
+
+TEST_CASE("concurrent_hashmap__parallel_compute")
+{
+    test_parallel_compute<gem::spinlock>();
+    test_parallel_compute<std::shared_mutex>();
+}
@@ -0,0 +1,129 @@
+#include "catch.hpp"
+#include <gem/epoch_hashmap.h>
+#include <thread>
+#include <vector>
+
+TEST_CASE("epoch_hashmap__put_get_remove")
+{
+    gem::epoch_hashmap<int> map;
+    REQUIRE(0 == map.size());
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE_FALSE(map.put("foo", 42));
+    REQUIRE(42 == *map.get("foo"));
+    REQUIRE(42 == *map.put("foo", 43));
+    REQUIRE(43 == *map.get("foo"));
+    REQUIRE_FALSE(map.put("bar", 44));
+    REQUIRE(2 == map.size());
+    REQUIRE(43 == *map.remove("foo"));
+    REQUIRE_FALSE(map.remove("foo"));
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE(44 == *map.get("bar"));
+    REQUIRE(1 == map.size());
+}
+
+TEST_CASE("epoch_hashmap__grow")
+{
+    gem::epoch_hashmap<int, 1> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE_FALSE(map.put(std::to_string(i), i));
+    }
+    REQUIRE(1000 == map.size());
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE(i == *map.get(std::to_string(i)));
+    }
+}
+
+TEST_CASE("epoch_hashmap__collect")
+{
+    gem::epoch_hashmap<int> map;
+    map.put("foo", 42);
+    map.put("foo", 43);
+    map.remove("foo");
+    REQUIRE(2 == map.domain().retired());
+    map.domain().collect();
+    REQUIRE(0 == map.domain().retired());
+}
+
+TEST_CASE("epoch_hashmap__more_readers_than_slots")
+{
+    gem::epoch_domain domain{1};
+    std::vector<gem::epoch_domain::guard> guards;
+    for (int i = 0; i < 5; ++i)
+    {
+        guards.push_back(domain.pin());
+    }
+    domain.retire(new int{42});
+    domain.collect();
+    REQUIRE(1 == domain.retired());
+    guards.clear();
+    domain.collect();
+    REQUIRE(0 == domain.retired());
+    const auto guard = domain.pin();
+}
+
+TEST_CASE("epoch_hashmap__retire_after_long_pin")
+{
+    gem::epoch_domain domain;
+    {
+        const auto guard = domain.pin();
+        for (int i = 0; i < 1000; ++i)
+        {
+            domain.retire(new int{i});
+        }
+        REQUIRE(1000 == domain.retired());
+    }
+    for (int i = 0; i < 2000; ++i)
+    {
+        domain.retire(new int{i});
+    }
+    REQUIRE(domain.retired() < 3000);
+}
+
+TEST_CASE("epoch_hashmap__readers_and_writer")
+{
+    gem::epoch_hashmap<int> map;
+    for (int i = 0; i < 100; ++i)
+    {
+        map.put(std::to_string(i), i);
+    }
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    std::atomic<int> errors{0};
+    for (int t = 0; t < 4; ++t)
+    {
+        readers.emplace_back([&] {
+            while (!done)
+            {
+                for (int i = 0; i < 100; ++i)
+                {
+                    const auto value = map.get(std::to_string(i));
+                    if (!value || *value % 100 != i)
+                    {
+                        ++errors;
+                    }
+                }
+            }
+        });
+    }
+    for (int round = 1; round < 50; ++round)
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            map.put(std::to_string(i), i + 100 * round);
+        }
+        for (int i = 100; i < 200; ++i)
+        {
+            map.put(std::to_string(i + 1000 * round), i);
+            map.remove(std::to_string(i + 1000 * round));
+        }
+    }
+    done = true;
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    REQUIRE(0 == errors);
+    REQUIRE(100 == map.size());
+}
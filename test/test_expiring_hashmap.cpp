@@ -0,0 +1,129 @@
+#include "catch.hpp"
+#include <gem/expiring_hashmap.h>
+#include <chrono>
+#include <string>
+#include <utility>
+
+namespace
+{
+
+struct manual_clock
+{
+    using duration = std::chrono::milliseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<manual_clock>;
+    static constexpr bool is_steady = true;
+
+    static time_point
+    now()
+    {
+        return current;
+    }
+
+    static time_point current;
+};
+
+manual_clock::time_point manual_clock::current{};
+
+using map_type = gem::expiring_hashmap<int, manual_clock>;
+
+} // namespace
+
+TEST_CASE("expiring_hashmap__put_get_remove")
+{
+    manual_clock::current = manual_clock::time_point{};
+    map_type map;
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE_FALSE(map.put("foo", 42));
+    REQUIRE(42 == *map.put("foo", 43, std::chrono::seconds{1}));
+    REQUIRE(43 == *map.get("foo"));
+    REQUIRE_FALSE(map.put("bar", 44));
+    REQUIRE(2 == map.size());
+    REQUIRE(43 == *map.remove("foo"));
+    REQUIRE_FALSE(map.remove("foo"));
+    REQUIRE(1 == map.size());
+    // the cancelled timer of foo does not expire anything
+    manual_clock::current += std::chrono::seconds{2};
+    REQUIRE(0 == map.expire_until(manual_clock::now()));
+    REQUIRE(44 == *map.get("bar"));
+}
+
+TEST_CASE("expiring_hashmap__lazy_expiry_on_get")
+{
+    manual_clock::current = manual_clock::time_point{std::chrono::hours{1}};
+    map_type map;
+    map.put("foo", 42, std::chrono::milliseconds{10});
+    manual_clock::current += std::chrono::milliseconds{9};
+    REQUIRE(42 == *map.get("foo"));
+    manual_clock::current += std::chrono::milliseconds{1};
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE(0 == map.size());
+    REQUIRE(0 == map.expire_until(manual_clock::now()));
+}
+
+TEST_CASE("expiring_hashmap__expire_until")
+{
+    manual_clock::current = manual_clock::time_point{};
+    map_type map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(std::to_string(i), i, std::chrono::milliseconds{i + 1});
+    }
+    map.put("forever", -1);
+    // replacing an entry reschedules it
+    map.put("0", 0, std::chrono::seconds{10});
+    const auto start = manual_clock::now();
+    REQUIRE(0 == map.expire_until(start));
+    REQUIRE(499 == map.expire_until(start + std::chrono::milliseconds{500}));
+    REQUIRE(502 == map.size());
+    REQUIRE_FALSE(map.get("1"));
+    REQUIRE(600 == *map.get("600"));
+    REQUIRE(500 == map.expire_until(start + std::chrono::seconds{1}));
+    REQUIRE(0 == *map.get("0"));
+    REQUIRE(1 == map.expire_until(start + std::chrono::seconds{10}));
+    REQUIRE(1 == map.size());
+    REQUIRE(-1 == *map.get("forever"));
+}
+
+TEST_CASE("expiring_hashmap__resolution")
+{
+    manual_clock::current = manual_clock::time_point{};
+    map_type map{std::chrono::milliseconds{100}};
+    map.put("foo", 42, std::chrono::milliseconds{150});
+    const auto start = manual_clock::now();
+    // expires in the tick after its deadline, never before it
+    REQUIRE(0 == map.expire_until(start + std::chrono::milliseconds{199}));
+    REQUIRE(1 == map.expire_until(start + std::chrono::milliseconds{200}));
+}
+
+TEST_CASE("expiring_hashmap__move")
+{
+    manual_clock::current = manual_clock::time_point{};
+    map_type source;
+    const std::string key(100, 'k');
+    source.put(key, 42, std::chrono::milliseconds{10});
+    source.put(std::string(100, 'l'), 43, std::chrono::milliseconds{20});
+    auto map = std::move(source);
+    const auto start = manual_clock::now();
+    REQUIRE(1 == map.expire_until(start + std::chrono::milliseconds{10}));
+    REQUIRE_FALSE(map.get(key));
+    REQUIRE(43 == *map.get(std::string(100, 'l')));
+    REQUIRE(1 == map.expire_until(start + std::chrono::milliseconds{20}));
+    REQUIRE(0 == map.size());
+}
+
+TEST_CASE("expiring_hashmap__reuse_moved_from")
+{
+    manual_clock::current = manual_clock::time_point{};
+    map_type map;
+    map.put("foo", 42, std::chrono::milliseconds{10});
+    map.put("bar", 43, std::chrono::milliseconds{10});
+    const auto other = std::move(map);
+    REQUIRE(2 == other.size());
+    REQUIRE(0 == map.size());
+    map.put("baz", 44, std::chrono::milliseconds{5});
+    const auto start = manual_clock::now();
+    REQUIRE(1 == map.expire_until(start + std::chrono::milliseconds{10}));
+    REQUIRE(0 == map.size());
+}
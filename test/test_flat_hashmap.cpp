@@ -0,0 +1,142 @@
+#include "catch.hpp"
+#include <gem/flat_hashmap.h>
+
+TEST_CASE("flat_hashmap__put_and_size")
+{
+    gem::flat_hashmap<int> map;
+    REQUIRE(0 == map.size());
+    REQUIRE_FALSE(map.put("foo", 42));
+    REQUIRE(1 == map.size());
+    REQUIRE(42 == *map.put("foo", 43));
+    REQUIRE(1 == map.size());
+    REQUIRE_FALSE(map.put("bar", 44));
+    REQUIRE(2 == map.size());
+}
+
+TEST_CASE("flat_hashmap__put_and_get")
+{
+    gem::flat_hashmap<int> map;
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE_FALSE(map.put("foo", 42));
+    REQUIRE(42 == *map.get("foo"));
+    REQUIRE(42 == *map.put("foo", 43));
+    REQUIRE(43 == *map.get("foo"));
+    REQUIRE_FALSE(map.put("bar", 44));
+    REQUIRE(44 == *map.get("bar"));
+}
+
+TEST_CASE("flat_hashmap__remove")
+{
+    gem::flat_hashmap<int> map;
+    REQUIRE_FALSE(map.remove("foo"));
+    map.put("foo", 42);
+    REQUIRE(42 == *map.remove("foo"));
+    REQUIRE(0 == map.size());
+    REQUIRE_FALSE(map.get("foo"));
+    map.put("foo", 42);
+    map.put("bar", 43);
+    REQUIRE(2 == map.size());
+    REQUIRE(42 == *map.remove("foo"));
+    REQUIRE(43 == *map.remove("bar"));
+    REQUIRE(0 == map.size());
+}
+
+TEST_CASE("flat_hashmap__grow_and_churn")
+{
+    gem::flat_hashmap<int> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE_FALSE(map.put(std::to_string(i), i));
+    }
+    REQUIRE(1000 == map.size());
+    REQUIRE(map.capacity() >= 1000);
+    for (int i = 0; i < 1000; i += 2)
+    {
+        REQUIRE(i == *map.remove(std::to_string(i)));
+    }
+    REQUIRE(500 == map.size());
+    for (int i = 0; i < 1000; ++i)
+    {
+        if (i % 2)
+        {
+            REQUIRE(i == *map.get(std::to_string(i)));
+        }
+        else
+        {
+            REQUIRE_FALSE(map.get(std::to_string(i)));
+        }
+    }
+    for (int i = 1000; i < 5000; ++i)
+    {
+        map.put(std::to_string(i), i);
+        map.remove(std::to_string(i - 1));
+    }
+    REQUIRE(500 == map.size());
+    REQUIRE(4999 == *map.get("4999"));
+}
+
+TEST_CASE("flat_hashmap__copy_constructor")
+{
+    gem::flat_hashmap<int> map;
+    map.put("foo", 42);
+    map.put("bar", 43);
+    gem::flat_hashmap<int> map2(map);
+    REQUIRE(2 == map.size());
+    REQUIRE(2 == map2.size());
+    map.put("foo", 44);
+    REQUIRE(42 == *map2.get("foo"));
+    REQUIRE(43 == *map2.get("bar"));
+}
+
+TEST_CASE("flat_hashmap__move_assignment")
+{
+    gem::flat_hashmap<int> map;
+    map.put("foo", 42);
+    map.put("bar", 43);
+    gem::flat_hashmap<int> map2;
+    map2.put("baz", 44);
+    map2 = std::move(map);
+    REQUIRE(0 == map.size());
+    REQUIRE(2 == map2.size());
+    REQUIRE(42 == *map2.get("foo"));
+    REQUIRE(43 == *map2.get("bar"));
+    REQUIRE_FALSE(map2.get("baz"));
+    REQUIRE_FALSE(map.get("foo"));
+}
+
+TEST_CASE("flat_hashmap__string_view_keys")
+{
+    gem::flat_hashmap<int> map;
+    const std::string buffer = "foo=42;bar=43";
+    const std::string_view view = buffer;
+    REQUIRE_FALSE(map.put(view.substr(0, 3), 42));
+    REQUIRE_FALSE(map.put(std::string{"bar"}, 43));
+    REQUIRE(42 == *map.get(view.substr(0, 3)));
+    REQUIRE(42 == *map.get("foo"));
+    REQUIRE(43 == *map.get(view.substr(7, 3)));
+    REQUIRE_FALSE(map.get(view.substr(0, 2)));
+    REQUIRE(43 == *map.remove(view.substr(7, 3)));
+    REQUIRE(1 == map.size());
+}
+
+TEST_CASE("flat_hashmap__ctrl_group_match")
+{
+    constexpr auto width = gem::detail::ctrl_group::width;
+    const std::int8_t states[] = {
+        5, static_cast<std::int8_t>(gem::detail::ctrl::empty),
+        static_cast<std::int8_t>(gem::detail::ctrl::deleted)};
+    std::int8_t ctrl[width];
+    std::uint32_t masks[3] = {};
+    for (std::size_t i = 0; i < width; ++i)
+    {
+        ctrl[i] = states[i % 3];
+        masks[i % 3] |= 1u << i;
+    }
+    const gem::detail::ctrl_group group{ctrl};
+    REQUIRE(masks[0] == group.match(5));
+    REQUIRE(0 == group.match(6));
+    REQUIRE(masks[1] == group.match_empty());
+    REQUIRE((masks[1] | masks[2]) == group.match_empty_or_deleted());
+    REQUIRE(3 == gem::detail::lowest_bit(0b11000));
+    REQUIRE(31 == gem::detail::lowest_bit(0x8000'0000u));
+}
@@ -1,5 +1,18 @@
 #include "catch.hpp"
 #include <gem/hashmap.h>
+#include <gem/node_pool.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 enum class type
 {
@@ -196,3 +209,600 @@ TEST_CASE("hashmap__move_assignment")
     test_move_assignment<0x3>();
     test_move_assignment<0x10000>();
 }
+
+template <std::size_t Buckets>
+void
+test_grow()
+{
+    gem::hashmap<int, Buckets> map;
+    REQUIRE(0 == map.bucket_count());
+    for (int i = 0; i < 10000; ++i)
+    {
+        REQUIRE_FALSE(map.put(std::to_string(i), i));
+        if (i % 7 == 0)
+        {
+            REQUIRE(i == *map.remove(std::to_string(i)));
+        }
+    }
+    REQUIRE(map.bucket_count() >= Buckets);
+    REQUIRE(map.bucket_count() <=
+            std::max<std::size_t>(Buckets, 2 * map.size()));
+    for (int i = 0; i < 10000; ++i)
+    {
+        if (i % 7 == 0)
+        {
+            REQUIRE_FALSE(map.get(std::to_string(i)));
+        }
+        else
+        {
+            REQUIRE(i == *map.get(std::to_string(i)));
+        }
+    }
+    gem::hashmap<int, Buckets> map2(map);
+    REQUIRE(map.size() == map2.size());
+    REQUIRE(9999 == *map2.get("9999"));
+}
+
+TEST_CASE("hashmap__grow")
+{
+    test_grow<0x1>();
+    test_grow<0x3>();
+    test_grow<0x10000>();
+}
+
+namespace
+{
+
+struct counting_observer : gem::ds::observer
+{
+    int calls = 0;
+    void
+    on_data_changed(const std::shared_ptr<gem::ds::data>&) override
+    {
+        ++calls;
+    }
+};
+
+} // namespace
+
+TEST_CASE("hashmap__observable_storage")
+{
+    gem::hashmap<int, 0x10, gem::observable_storage> map;
+    REQUIRE_FALSE(map.data("foo"));
+    map.put("foo", 42);
+    const auto value = map.data("foo");
+    REQUIRE(value);
+    REQUIRE("foo" == value->name());
+    auto observer = std::make_shared<counting_observer>();
+    value->add_observer(observer);
+    REQUIRE(42 == *map.put("foo", 43));
+    REQUIRE(1 == observer->calls);
+    REQUIRE(43 == *value->get());
+    REQUIRE(43 == *map.get("foo"));
+    gem::hashmap<int, 0x10, gem::observable_storage> map2(map);
+    REQUIRE(43 == *map2.get("foo"));
+    REQUIRE(value != map2.data("foo"));
+    REQUIRE(43 == *map.remove("foo"));
+    REQUIRE_FALSE(map.data("foo"));
+}
+
+TEST_CASE("hashmap__string_view_keys")
+{
+    gem::hashmap<int> map;
+    const std::string buffer = "foo=42;bar=43";
+    const std::string_view view = buffer;
+    REQUIRE_FALSE(map.put(view.substr(0, 3), 42));
+    REQUIRE_FALSE(map.put(std::string{"bar"}, 43));
+    REQUIRE(42 == *map.get(view.substr(0, 3)));
+    REQUIRE(42 == *map.get("foo"));
+    REQUIRE(43 == *map.get(view.substr(7, 3)));
+    REQUIRE_FALSE(map.get(view.substr(0, 2)));
+    REQUIRE(43 == *map.put(view.substr(7, 3), 44));
+    REQUIRE(44 == *map.remove(view.substr(7, 3)));
+    REQUIRE(1 == map.size());
+}
+
+namespace
+{
+
+struct colliding_hash
+{
+    std::size_t
+    operator()(const std::string_view key) const
+    {
+        return key.size();
+    }
+};
+
+} // namespace
+
+TEST_CASE("hashmap__custom_hash")
+{
+    gem::hashmap<int, 0x10, gem::plain_storage, colliding_hash> map;
+    for (int i = 100; i < 200; ++i)
+    {
+        REQUIRE_FALSE(map.put(std::to_string(i), i));
+    }
+    for (int i = 100; i < 200; ++i)
+    {
+        REQUIRE(i == *map.get(std::to_string(i)));
+    }
+    auto map2 = map;
+    REQUIRE(100 == map2.size());
+    REQUIRE(150 == *map2.remove("150"));
+    REQUIRE(150 == *map.get("150"));
+    REQUIRE_FALSE(map2.get("150"));
+}
+
+TEST_CASE("hashmap__default_hash_is_transparent")
+{
+    const std::string key = "http://example.com/some/long/path?with=query";
+    const gem::hash hash;
+    REQUIRE(hash(key) == hash(std::string_view{key}));
+    REQUIRE(hash(key) == hash(key.c_str()));
+    REQUIRE(hash(key) != hash(key.substr(1)));
+    REQUIRE(hash("") != hash("a"));
+}
+
+TEST_CASE("hashmap__iteration")
+{
+    gem::hashmap<int, 0x2> map;
+    REQUIRE(map.begin() == map.end());
+    int expected = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(std::to_string(i), i);
+        expected += i;
+    }
+    int sum = 0;
+    std::size_t count = 0;
+    for (const auto& [key, value] : map)
+    {
+        REQUIRE(std::to_string(value) == key);
+        sum += value;
+        ++count;
+    }
+    REQUIRE(1000 == count);
+    REQUIRE(expected == sum);
+    REQUIRE(1000 == std::distance(map.begin(), map.end()));
+    sum = 0;
+    map.for_each([&sum](const std::string& key, const int value) {
+        REQUIRE(std::to_string(value) == key);
+        sum += value;
+    });
+    REQUIRE(expected == sum);
+}
+
+TEST_CASE("hashmap__parallel_for_each_and_reduce")
+{
+    gem::hashmap<int> map;
+    REQUIRE(0 == map.parallel_reduce(
+                     0,
+                     [](const std::string&, const int value) { return value; },
+                     [](const int lhs, const int rhs) { return lhs + rhs; }));
+    long long expected = 0;
+    for (int i = 0; i < 5000; ++i)
+    {
+        map.put(std::to_string(i), i);
+        expected += i;
+    }
+    for (const std::size_t threads : {1, 3, 8})
+    {
+        REQUIRE(expected ==
+                map.parallel_reduce(
+                    0ll,
+                    [](const std::string&, const int value) {
+                        return static_cast<long long>(value);
+                    },
+                    [](const long long lhs, const long long rhs) {
+                        return lhs + rhs;
+                    },
+                    threads));
+        std::atomic<long long> sum{0};
+        map.parallel_for_each(
+            [&sum](const std::string&, const int value) { sum += value; },
+            threads);
+        REQUIRE(expected == sum);
+    }
+}
+
+TEST_CASE("hashmap__parallel_threads_are_clamped")
+{
+    gem::hashmap<int> map;
+    for (int i = 0; i < 5000; ++i)
+    {
+        map.put(std::to_string(i), i);
+    }
+    std::mutex mutex;
+    std::set<std::thread::id> ids;
+    std::atomic<int> count{0};
+    map.parallel_for_each(
+        [&](const std::string&, int) {
+            count++;
+            std::lock_guard lock{mutex};
+            ids.insert(std::this_thread::get_id());
+        },
+        100000);
+    REQUIRE(5000 == count);
+    REQUIRE(ids.size() <= std::max(1u, std::thread::hardware_concurrency()));
+}
+
+TEST_CASE("hashmap__get_many_and_put_many")
+{
+    gem::hashmap<int, 0x4> map;
+    std::vector<std::pair<std::string, int>> entries;
+    for (int i = 0; i < 100; ++i)
+    {
+        entries.emplace_back(std::to_string(i), i);
+    }
+    map.put_many(entries.begin(), entries.end());
+    REQUIRE(100 == map.size());
+    std::vector<std::string_view> keys;
+    for (int i = 0; i < 150; ++i)
+    {
+        keys.push_back(i < 100 ? std::string_view{entries[i].first}
+                               : std::string_view{"missing"});
+    }
+    std::vector<std::optional<int>> values;
+    map.get_many(keys.begin(), keys.end(), std::back_inserter(values));
+    REQUIRE(150 == values.size());
+    for (int i = 0; i < 150; ++i)
+    {
+        if (i < 100)
+        {
+            REQUIRE(i == *values[i]);
+        }
+        else
+        {
+            REQUIRE_FALSE(values[i]);
+        }
+    }
+    std::vector<std::reference_wrapper<const std::optional<int>>> refs;
+    map.get_many(keys.begin(), keys.begin() + 3, std::back_inserter(refs));
+    REQUIRE(3 == refs.size());
+    REQUIRE(&map.get("2") == &refs[2].get());
+}
+
+namespace
+{
+
+// Yields the keys "0", "1", ... by value, like a transform iterator
+struct key_iterator
+{
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::string;
+
+    int index;
+
+    std::string
+    operator*() const
+    {
+        // too long for the small string buffer
+        return std::string(40, 'x') + std::to_string(index);
+    }
+
+    key_iterator&
+    operator++()
+    {
+        ++index;
+        return *this;
+    }
+
+    bool
+    operator!=(const key_iterator& other) const
+    {
+        return index != other.index;
+    }
+};
+
+} // namespace
+
+TEST_CASE("hashmap__get_many_with_keys_by_value")
+{
+    gem::hashmap<int, 0x4> map;
+    for (int i = 0; i < 40; ++i)
+    {
+        map.put(*key_iterator{i}, i);
+    }
+    std::vector<std::optional<int>> values;
+    map.get_many(key_iterator{0}, key_iterator{50}, std::back_inserter(values));
+    REQUIRE(50 == values.size());
+    for (int i = 0; i < 50; ++i)
+    {
+        if (i < 40)
+        {
+            REQUIRE(i == *values[i]);
+        }
+        else
+        {
+            REQUIRE_FALSE(values[i]);
+        }
+    }
+}
+
+TEST_CASE("hashmap__node_pool")
+{
+    using map_type = gem::hashmap<int,
+                                  0x10,
+                                  gem::plain_storage,
+                                  gem::hash,
+                                  gem::node_pool<int, 64>>;
+    map_type map;
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            map.put(std::to_string(i), i);
+        }
+        for (int i = 0; i < 1000; i += 2)
+        {
+            REQUIRE(i == *map.remove(std::to_string(i)));
+        }
+    }
+    REQUIRE(500 == map.size());
+    map_type map2(map);
+    map_type map3;
+    map3 = map;
+    map_type map4(std::move(map));
+    REQUIRE(500 == map2.size());
+    REQUIRE(500 == map3.size());
+    REQUIRE(500 == map4.size());
+    REQUIRE(999 == *map2.get("999"));
+    REQUIRE(999 == *map3.get("999"));
+    REQUIRE(999 == *map4.get("999"));
+}
+
+TEST_CASE("hashmap__integral_keys")
+{
+    static_assert(std::is_same_v<gem::basic_hashmap<std::string, int>,
+                                 gem::hashmap<int>>);
+    gem::basic_hashmap<std::uint64_t, int> map;
+    for (std::uint64_t i = 0; i < 1000; ++i)
+    {
+        REQUIRE_FALSE(map.put(i << 20, static_cast<int>(i)));
+    }
+    REQUIRE(1000 == map.size());
+    REQUIRE(7 == *map.get(std::uint64_t{7} << 20));
+    REQUIRE_FALSE(map.get(7));
+    REQUIRE(7 == *map.remove(std::uint64_t{7} << 20));
+    REQUIRE(999 == map.size());
+    for (const auto& [key, value] : map)
+    {
+        REQUIRE(key == static_cast<std::uint64_t>(value) << 20);
+    }
+}
+
+namespace
+{
+
+struct uuid
+{
+    std::uint64_t high;
+    std::uint64_t low;
+
+    bool
+    operator==(const uuid& other) const
+    {
+        return high == other.high && low == other.low;
+    }
+};
+
+} // namespace
+
+TEST_CASE("hashmap__trivially_copyable_keys")
+{
+    gem::basic_hashmap<uuid, int> map;
+    REQUIRE_FALSE(map.put(uuid{1, 2}, 42));
+    REQUIRE_FALSE(map.put(uuid{2, 1}, 43));
+    REQUIRE(42 == *map.put(uuid{1, 2}, 44));
+    REQUIRE(44 == *map.get(uuid{1, 2}));
+    REQUIRE(43 == *map.get(uuid{2, 1}));
+    REQUIRE_FALSE(map.get(uuid{1, 1}));
+    REQUIRE(2 == map.size());
+}
+
+TEST_CASE("hashmap__node_pool_bulk_release")
+{
+    using map_type = gem::hashmap<int,
+                                  0x10,
+                                  gem::plain_storage,
+                                  gem::hash,
+                                  gem::node_pool<int>,
+                                  int>;
+    map_type map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(i, i);
+    }
+    map_type map2;
+    map2 = map;
+    map = map_type{};
+    REQUIRE(0 == map.size());
+    REQUIRE(1000 == map2.size());
+    REQUIRE(999 == *map2.get(999));
+}
+
+TEST_CASE("hashmap__stats")
+{
+    gem::hashmap<int, 0x10, gem::plain_storage, colliding_hash> map;
+    auto stats = map.stats();
+    REQUIRE(0 == stats.size);
+    REQUIRE(0 == stats.bucket_count);
+    REQUIRE(0 == stats.max_chain);
+    REQUIRE(stats.probe_lengths.empty());
+    for (int i = 100; i < 110; ++i)
+    {
+        map.put(std::to_string(i), i);
+    }
+    map.put("1", 1);
+    stats = map.stats();
+    REQUIRE(11 == stats.size);
+    REQUIRE(16 == stats.bucket_count);
+    REQUIRE(2 == stats.occupied_buckets);
+    REQUIRE(10 == stats.max_chain);
+    REQUIRE(5.5 == stats.mean_chain);
+    REQUIRE(10 == stats.probe_lengths.size());
+    REQUIRE(2 == stats.probe_lengths[0]);
+    REQUIRE(1 == stats.probe_lengths[9]);
+    REQUIRE(stats.memory > 11 * sizeof(int));
+    REQUIRE(0 == stats.counts.puts);
+    REQUIRE(0 == stats.counts.gets);
+}
+
+TEST_CASE("hashmap__counters")
+{
+    gem::hashmap<int,
+                 0x10,
+                 gem::plain_storage,
+                 gem::hash,
+                 std::allocator<int>,
+                 std::string,
+                 true>
+        map;
+    map.put("foo", 1);
+    map.put("foo", 2);
+    map.get("foo");
+    map.get("bar");
+    const std::string_view keys[] = {"foo", "baz"};
+    std::vector<std::optional<int>> values;
+    map.get_many(std::begin(keys), std::end(keys), std::back_inserter(values));
+    map.remove("foo");
+    map.remove("foo");
+    const auto counts = map.stats().counts;
+    REQUIRE(2 == counts.puts);
+    REQUIRE(4 == counts.gets);
+    REQUIRE(2 == counts.hits);
+    REQUIRE(2 == counts.misses);
+    REQUIRE(2 == counts.removes);
+}
+
+TEST_CASE("hashmap__save_and_load")
+{
+    gem::hashmap<std::string> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(std::to_string(i),
+                std::string(static_cast<std::size_t>(i), 'x'));
+    }
+    std::stringstream stream;
+    map.save(stream);
+    gem::hashmap<std::string> map2;
+    map2.put("foo", std::string{"bar"});
+    map2.load(stream);
+    REQUIRE(1001 == map2.size());
+    REQUIRE(1024 == map2.bucket_count());
+    REQUIRE("bar" == *map2.get("foo"));
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE(*map.get(std::to_string(i)) == *map2.get(std::to_string(i)));
+    }
+}
+
+TEST_CASE("hashmap__save_and_load_trivially_copyable")
+{
+    gem::basic_hashmap<std::uint64_t, int> map;
+    for (std::uint64_t i = 0; i < 300; ++i)
+    {
+        map.put(i << 40, static_cast<int>(i));
+    }
+    std::stringstream stream;
+    map.save(stream);
+    gem::basic_hashmap<std::uint64_t, int> map2;
+    map2.load(stream);
+    REQUIRE(300 == map2.size());
+    for (std::uint64_t i = 0; i < 300; ++i)
+    {
+        REQUIRE(static_cast<int>(i) == *map2.get(i << 40));
+    }
+}
+
+TEST_CASE("hashmap__load_errors")
+{
+    gem::hashmap<int> map;
+    std::stringstream garbage{"not a hashmap"};
+    REQUIRE_THROWS_AS(map.load(garbage), gem::serialization_error);
+    map.put("foo", 42);
+    std::stringstream stream;
+    map.save(stream);
+    auto data = stream.str();
+    data.pop_back();
+    std::stringstream truncated{data};
+    gem::hashmap<int> map2;
+    REQUIRE_THROWS_AS(map2.load(truncated), gem::serialization_error);
+}
+
+TEST_CASE("hashmap__bulk_load")
+{
+    std::vector<std::pair<std::string, int>> entries;
+    for (int i = 0; i < 1000; ++i)
+    {
+        entries.emplace_back(std::to_string(i), i);
+    }
+    gem::hashmap<int,
+                 0x10,
+                 gem::plain_storage,
+                 gem::hash,
+                 gem::node_pool<int>>
+        map;
+    map.bulk_load(entries.begin(), entries.end());
+    REQUIRE(1000 == map.size());
+    // the table was sized once and never needed to grow
+    REQUIRE(1024 == map.bucket_count());
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE(i == *map.get(std::to_string(i)));
+    }
+}
+
+TEST_CASE("hashmap__load_corrupt_sizes")
+{
+    const auto header = [](const std::uint64_t count) {
+        std::stringstream stream;
+        stream.write("gemhmap1", 8);
+        gem::detail::write_varint(stream, count);
+        return stream.str();
+    };
+    for (const auto count : {std::uint64_t{1} << 40,
+                             (std::uint64_t{1} << 63) + 1,
+                             UINT64_MAX})
+    {
+        std::stringstream stream{header(count)};
+        gem::hashmap<int> map;
+        REQUIRE_THROWS_AS(map.load(stream), gem::serialization_error);
+    }
+    // a key claiming to be far longer than the stream
+    std::stringstream stream;
+    stream << header(1);
+    gem::detail::write_varint(stream, std::uint64_t{1} << 40);
+    stream << "short";
+    gem::hashmap<int> map;
+    REQUIRE_THROWS_AS(map.load(stream), gem::serialization_error);
+    REQUIRE_THROWS_AS(map.reserve(SIZE_MAX), std::length_error);
+}
+
+TEST_CASE("hashmap__load_overlong_varint")
+{
+    std::stringstream max{std::string(9, '\xFF') + '\x01'};
+    REQUIRE(UINT64_MAX == gem::detail::read_varint(max));
+    // a count of 2 << 63 would wrap around to an empty map
+    std::stringstream stream;
+    stream.write("gemhmap1", 8);
+    stream << std::string(9, '\x80') << '\x02';
+    gem::hashmap<int> map;
+    REQUIRE_THROWS_AS(map.load(stream), gem::serialization_error);
+}
+
+TEST_CASE("hashmap__hashed_functions")
+{
+    gem::hashmap<int> map;
+    const auto h = map.hash("foo");
+    REQUIRE(h == gem::hash{}("foo"));
+    REQUIRE_FALSE(map.put_hashed(std::string{"foo"}, h, 42));
+    REQUIRE(42 == *map.get("foo"));
+    REQUIRE(42 == *map.get_hashed("foo", h));
+    REQUIRE(42 == *map.remove_hashed("foo", h));
+    REQUIRE_FALSE(map.get("foo"));
+}
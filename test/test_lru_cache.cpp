@@ -0,0 +1,205 @@
+#include "catch.hpp"
+#include <gem/lru_cache.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+TEST_CASE("lru_cache__put_get_remove")
+{
+    gem::lru_cache<int> cache{10};
+    REQUIRE(0 == cache.size());
+    REQUIRE(10 == cache.capacity());
+    REQUIRE_FALSE(cache.get("foo"));
+    REQUIRE_FALSE(cache.put("foo", 42));
+    REQUIRE(42 == *cache.get("foo"));
+    REQUIRE(42 == *cache.put("foo", 43));
+    REQUIRE(43 == *cache.peek("foo"));
+    REQUIRE_FALSE(cache.put("bar", 44));
+    REQUIRE(2 == cache.size());
+    REQUIRE(2 == cache.weight());
+    REQUIRE(43 == *cache.remove("foo"));
+    REQUIRE_FALSE(cache.remove("foo"));
+    REQUIRE_FALSE(cache.get("foo"));
+    REQUIRE(1 == cache.size());
+    REQUIRE(1 == cache.weight());
+}
+
+TEST_CASE("lru_cache__evicts_least_recently_used")
+{
+    std::vector<std::pair<std::string, int>> evicted;
+    gem::lru_cache<int> cache{
+        3, [&evicted](const std::string& key, int&& value) {
+            evicted.emplace_back(key, value);
+        }};
+    cache.put("a", 1);
+    cache.put("b", 2);
+    cache.put("c", 3);
+    REQUIRE(1 == *cache.get("a"));
+    cache.put("d", 4);
+    REQUIRE(3 == cache.size());
+    REQUIRE(1 == evicted.size());
+    REQUIRE("b" == evicted[0].first);
+    REQUIRE(2 == evicted[0].second);
+    REQUIRE_FALSE(cache.peek("b"));
+    // peek does not promote
+    REQUIRE(3 == *cache.peek("c"));
+    cache.put("a", 5);
+    cache.put("e", 6);
+    REQUIRE(2 == evicted.size());
+    REQUIRE("c" == evicted[1].first);
+    REQUIRE(5 == *cache.get("a"));
+    REQUIRE(4 == *cache.get("d"));
+    REQUIRE(6 == *cache.get("e"));
+}
+
+TEST_CASE("lru_cache__weights")
+{
+    const auto weigher = [](const std::string& value) { return value.size(); };
+    std::vector<std::string> evicted;
+    gem::lru_cache<std::string, decltype(weigher)> cache{
+        10,
+        [&evicted](const std::string& key, std::string&&) {
+            evicted.push_back(key);
+        },
+        weigher};
+    cache.put("a", std::string(4, 'a'));
+    cache.put("b", std::string(4, 'b'));
+    REQUIRE(8 == cache.weight());
+    cache.put("a", std::string(2, 'a'));
+    REQUIRE(6 == cache.weight());
+    cache.put("c", std::string(5, 'c'));
+    REQUIRE(std::vector<std::string>{"b"} == evicted);
+    REQUIRE(7 == cache.weight());
+    // heavier than the whole cache
+    cache.put("d", std::string(11, 'd'));
+    REQUIRE(0 == cache.size());
+    REQUIRE(0 == cache.weight());
+    REQUIRE(std::vector<std::string>{"b", "a", "c", "d"} == evicted);
+}
+
+TEST_CASE("lru_cache__reuses_slots")
+{
+    gem::lru_cache<int, gem::unit_weight, gem::hash, int> cache{100};
+    for (int i = 0; i < 10000; ++i)
+    {
+        cache.put(i, i);
+        REQUIRE(i == *cache.get(i));
+    }
+    REQUIRE(100 == cache.size());
+    for (int i = 0; i < 9900; ++i)
+    {
+        REQUIRE_FALSE(cache.peek(i));
+    }
+    for (int i = 9900; i < 10000; ++i)
+    {
+        REQUIRE(i == *cache.peek(i));
+    }
+}
+
+TEST_CASE("lru_cache__concurrent")
+{
+    gem::concurrent_lru_cache<int, 4> cache{100};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&cache, t] {
+            for (int i = 0; i < 1000; ++i)
+            {
+                cache.put(std::to_string(t * 1000 + i), i);
+                cache.get(std::to_string(t * 1000 + i / 2));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    REQUIRE(100 == cache.size());
+    REQUIRE_FALSE(cache.put("foo", 42));
+    REQUIRE(42 == *cache.get("foo"));
+    REQUIRE(42 == *cache.remove("foo"));
+    REQUIRE_FALSE(cache.get("foo"));
+    REQUIRE(99 == cache.size());
+}
+
+TEST_CASE("lru_cache__concurrent_capacity_below_shards")
+{
+    gem::concurrent_lru_cache<int> cache{10};
+    for (int i = 0; i < 100; ++i)
+    {
+        const auto key = std::to_string(i);
+        cache.put(key, i);
+        REQUIRE(i == *cache.get(key));
+    }
+    REQUIRE(10 >= cache.size());
+    gem::concurrent_lru_cache<int> single{1};
+    single.put("a", 1);
+    single.put("b", 2);
+    REQUIRE_FALSE(single.get("a"));
+    REQUIRE(2 == *single.get("b"));
+}
+
+TEST_CASE("lru_cache__long_keys")
+{
+    gem::lru_cache<int> cache{50};
+    const auto key = [](const int i) {
+        return std::string(100, 'k') + std::to_string(i);
+    };
+    for (int i = 0; i < 1000; ++i)
+    {
+        cache.put(key(i), i);
+        if (i % 3 == 0 && i < 900)
+        {
+            cache.remove(key(i - 1));
+        }
+    }
+    REQUIRE(50 == cache.size());
+    for (int i = 950; i < 1000; ++i)
+    {
+        REQUIRE(i == *cache.peek(key(i)));
+    }
+    REQUIRE_FALSE(cache.get(key(949)));
+}
+
+TEST_CASE("lru_cache__copy_and_move")
+{
+    const auto key = [](const int i) {
+        return std::string(100, 'k') + std::to_string(i);
+    };
+    auto original = std::make_unique<gem::lru_cache<int>>(3);
+    for (int i = 0; i < 5; ++i)
+    {
+        original->put(key(i), i);
+    }
+    original->remove(key(3));
+    gem::lru_cache<int> copy{*original};
+    gem::lru_cache<int> assigned{1};
+    assigned = *original;
+    original.reset();
+    for (auto cache : {&copy, &assigned})
+    {
+        REQUIRE(2 == cache->size());
+        REQUIRE(2 == *cache->get(key(2)));
+        REQUIRE(4 == *cache->get(key(4)));
+        REQUIRE_FALSE(cache->get(key(3)));
+        // the slot of the removed entry is reused
+        cache->put(key(5), 5);
+        cache->put(key(6), 6);
+        REQUIRE_FALSE(cache->get(key(2)));
+        REQUIRE(4 == *cache->get(key(4)));
+    }
+
+    auto moved = std::move(copy);
+    REQUIRE(3 == moved.size());
+    REQUIRE(6 == *moved.get(key(6)));
+    // the moved-from cache is empty and usable
+    REQUIRE(0 == copy.size());
+    REQUIRE_FALSE(copy.get(key(6)));
+    copy.put(key(7), 7);
+    REQUIRE(7 == *copy.get(key(7)));
+    assigned = std::move(moved);
+    REQUIRE(6 == *assigned.get(key(6)));
+    REQUIRE(0 == moved.size());
+}
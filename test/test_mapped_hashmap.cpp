@@ -0,0 +1,195 @@
+#include "catch.hpp"
+#include <gem/hashmap.h>
+#include <gem/mapped_hashmap.h>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct point
+{
+    double x;
+    double y;
+};
+
+std::string
+temp_file(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+} // namespace
+
+TEST_CASE("mapped_hashmap__trivially_copyable_values")
+{
+    const auto path = temp_file("gem_mapped_hashmap_points");
+    gem::hashmap<point> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(std::to_string(i), point{double(i), -double(i)});
+    }
+    gem::mapped_hashmap<point>::write(path, map);
+    const gem::mapped_hashmap<point> mapped{path};
+    REQUIRE(1000 == mapped.size());
+    REQUIRE(1024 == mapped.bucket_count());
+    for (int i = 0; i < 1000; ++i)
+    {
+        const auto value = mapped.get(std::to_string(i));
+        REQUIRE(value);
+        REQUIRE(i == value->x);
+        REQUIRE(-i == value->y);
+    }
+    REQUIRE_FALSE(mapped.get("foo"));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mapped_hashmap__string_values")
+{
+    const auto path = temp_file("gem_mapped_hashmap_strings");
+    const std::map<std::string, std::string> map{
+        {"foo", "bar"}, {"", "empty key"}, {"empty value", ""}};
+    gem::mapped_hashmap<std::string>::write(path, map);
+    const gem::mapped_hashmap<std::string> mapped{path};
+    REQUIRE(3 == mapped.size());
+    REQUIRE("bar" == *mapped.get("foo"));
+    REQUIRE("empty key" == *mapped.get(""));
+    REQUIRE(mapped.get("empty value")->empty());
+    REQUIRE_FALSE(mapped.get("bar"));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mapped_hashmap__empty")
+{
+    const auto path = temp_file("gem_mapped_hashmap_empty");
+    gem::mapped_hashmap<int>::write(path, gem::hashmap<int>{});
+    const gem::mapped_hashmap<int> mapped{path};
+    REQUIRE(0 == mapped.size());
+    REQUIRE_FALSE(mapped.get("foo"));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mapped_hashmap__replace_while_mapped")
+{
+    const auto path = temp_file("gem_mapped_hashmap_replace");
+    gem::hashmap<int> map;
+    map.put("foo", 1);
+    gem::mapped_hashmap<int>::write(path, map);
+    const gem::mapped_hashmap<int> old_mapped{path};
+    map.put("foo", 2);
+    gem::mapped_hashmap<int>::write(path, map);
+    const gem::mapped_hashmap<int> new_mapped{path};
+    REQUIRE(1 == *old_mapped.get("foo"));
+    REQUIRE(2 == *new_mapped.get("foo"));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mapped_hashmap__errors")
+{
+    REQUIRE_THROWS_AS(gem::mapped_hashmap<int>{temp_file("gem_no_such_file")},
+                      gem::mapped_error);
+    const auto path = temp_file("gem_mapped_hashmap_errors");
+    gem::hashmap<int> map;
+    map.put("foo", 1);
+    gem::mapped_hashmap<int>::write(path, map);
+    REQUIRE_THROWS_AS(gem::mapped_hashmap<double>{path}, gem::mapped_error);
+    REQUIRE_THROWS_AS(gem::mapped_hashmap<std::string>{path},
+                      gem::mapped_error);
+    {
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        file << "not a mapped hashmap at all, just some text in a file";
+    }
+    REQUIRE_THROWS_AS(gem::mapped_hashmap<int>{path}, gem::mapped_error);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("mapped_hashmap__concurrent_writers")
+{
+    const auto dir = std::filesystem::temp_directory_path() /
+        "gem_mapped_hashmap_writers";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directory(dir);
+    const auto path = (dir / "map").string();
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t)
+    {
+        writers.emplace_back([&path, t] {
+            gem::hashmap<int> map;
+            for (int i = 0; i < 1000; ++i)
+            {
+                map.put(std::to_string(i), t);
+            }
+            for (int round = 0; round < 10; ++round)
+            {
+                gem::mapped_hashmap<int>::write(path, map);
+            }
+        });
+    }
+    for (auto& writer : writers)
+    {
+        writer.join();
+    }
+    // one writer's file won and no temporary file is left behind
+    const gem::mapped_hashmap<int> mapped{path};
+    REQUIRE(1000 == mapped.size());
+    const auto t = *mapped.get("0");
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE(t == *mapped.get(std::to_string(i)));
+    }
+    REQUIRE(1 == std::distance(std::filesystem::directory_iterator{dir},
+                               std::filesystem::directory_iterator{}));
+    REQUIRE_THROWS_AS(
+        gem::mapped_hashmap<int>::write((dir / "missing" / "map").string(),
+                                        gem::hashmap<int>{}),
+        gem::mapped_error);
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("mapped_hashmap__corrupt_offsets")
+{
+    using gem::detail::mapped_entry;
+    using gem::detail::mapped_header;
+    const auto path = temp_file("gem_mapped_hashmap_corrupt");
+    gem::hashmap<int> map;
+    map.put("foo", 1);
+    const auto corrupt = [&](const auto& patch) {
+        gem::mapped_hashmap<int>::write(path, map);
+        std::fstream file{path,
+                          std::ios::binary | std::ios::in | std::ios::out};
+        mapped_header header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        patch(file, header);
+    };
+
+    // an entry's key points past the end of the file
+    corrupt([](std::fstream& file, const mapped_header& header) {
+        mapped_entry entry;
+        file.seekg(static_cast<std::streamoff>(header.entries));
+        file.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+        entry.key = std::uint64_t{1} << 40;
+        file.seekp(static_cast<std::streamoff>(header.entries));
+        file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    });
+    REQUIRE_THROWS_AS(gem::mapped_hashmap<int>{path}.get("foo"),
+                      gem::mapped_error);
+
+    // a bucket range reaches beyond the entries
+    corrupt([](std::fstream& file, const mapped_header& header) {
+        const std::vector<std::uint64_t> buckets(header.bucket_count + 1, 5);
+        file.seekp(static_cast<std::streamoff>(header.buckets));
+        file.write(reinterpret_cast<const char*>(buckets.data()),
+                   static_cast<std::streamsize>(buckets.size() *
+                                                sizeof(std::uint64_t)));
+    });
+    REQUIRE_THROWS_AS(gem::mapped_hashmap<int>{path}.get("foo"),
+                      gem::mapped_error);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,137 @@
+#include "catch.hpp"
+#include <gem/mpmc_circular_buffer.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("mpmc_circular_buffer__push_and_pop")
+{
+    gem::mpmc_circular_buffer<std::string, 4> buffer;
+    static_assert(4 == buffer.capacity(), "");
+    std::string value;
+    REQUIRE_FALSE(buffer.try_pop(value));
+    for (int lap = 0; lap < 3; ++lap)
+    {
+        REQUIRE(buffer.try_push(std::string{"a"}));
+        REQUIRE(buffer.try_push(std::string{"b"}));
+        REQUIRE(buffer.try_emplace(2, 'c'));
+        REQUIRE(buffer.try_push(std::string{"d"}));
+        REQUIRE(4 == buffer.size());
+        REQUIRE_FALSE(buffer.try_push(std::string{"e"}));
+        for (const auto expected : {"a", "b", "cc", "d"})
+        {
+            REQUIRE(buffer.try_pop(value));
+            REQUIRE(expected == value);
+        }
+        REQUIRE(0 == buffer.size());
+        REQUIRE_FALSE(buffer.try_pop(value));
+    }
+}
+
+TEST_CASE("mpmc_circular_buffer__push_n_and_pop_n")
+{
+    gem::mpmc_circular_buffer<int, 8> buffer;
+    const std::vector<int> values{1, 2, 3, 4, 5, 6};
+    REQUIRE(6 == buffer.try_push_n(values.begin(), values.size()));
+    REQUIRE(2 == buffer.try_push_n(values.begin(), values.size()));
+    std::vector<int> popped(10);
+    REQUIRE(5 == buffer.try_pop_n(popped.begin(), 5));
+    REQUIRE(3 == buffer.try_pop_n(popped.begin() + 5, 5));
+    REQUIRE(0 == buffer.try_pop_n(popped.begin(), 5));
+    REQUIRE(std::vector<int>{1, 2, 3, 4, 5, 6, 1, 2, 0, 0} == popped);
+}
+
+TEST_CASE("mpmc_circular_buffer__push_n_and_pop_n_nothing")
+{
+    gem::mpmc_circular_buffer<int, 4> buffer;
+    const std::vector<int> values{1, 2};
+    REQUIRE(0 == buffer.try_push_n(values.begin(), 0));
+    REQUIRE(0 == buffer.size());
+    REQUIRE(2 == buffer.try_push_n(values.begin(), values.size()));
+    REQUIRE(0 == buffer.try_push_n(values.begin(), 0));
+    REQUIRE(2 == buffer.size());
+    std::vector<int> popped(2);
+    REQUIRE(0 == buffer.try_pop_n(popped.begin(), 0));
+    REQUIRE(2 == buffer.size());
+}
+
+TEST_CASE("mpmc_circular_buffer__destroys_remaining_values")
+{
+    auto value = std::make_shared<int>(42);
+    {
+        gem::mpmc_circular_buffer<std::shared_ptr<int>, 4> buffer;
+        REQUIRE(buffer.try_push(value));
+        REQUIRE(buffer.try_push(value));
+        std::shared_ptr<int> popped;
+        REQUIRE(buffer.try_pop(popped));
+        REQUIRE(3 == value.use_count());
+    }
+    REQUIRE(1 == value.use_count());
+}
+
+TEST_CASE("mpmc_circular_buffer__producers_and_consumers")
+{
+    constexpr int producers = 3;
+    constexpr int consumers = 3;
+    constexpr int count = 20000;
+    gem::mpmc_circular_buffer<int, 64> buffer;
+    std::atomic<long long> sum{0};
+    std::atomic<int> popped{0};
+    std::atomic<int> out_of_order{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&buffer, p] {
+            for (int i = 0; i < count;)
+            {
+                // values encode their producer to check the order per producer
+                int batch[4];
+                for (int j = 0; j < 4; ++j)
+                {
+                    batch[j] = p * count + i + j;
+                }
+                const auto want = std::min(4 - (i % 2), count - i);
+                const auto n = static_cast<int>(
+                    buffer.try_push_n(batch, static_cast<std::size_t>(want)));
+                i += n;
+                if (!n)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&] {
+            int last[producers] = {-1, -1, -1};
+            while (popped.load() < producers * count)
+            {
+                int value;
+                if (!buffer.try_pop(value))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (value % count <= last[value / count])
+                {
+                    out_of_order++;
+                }
+                last[value / count] = value % count;
+                sum += value;
+                popped++;
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const long long total = producers * count;
+    REQUIRE(total * (total - 1) / 2 == sum.load());
+    REQUIRE(0 == out_of_order.load());
+    REQUIRE(0 == buffer.size());
+}
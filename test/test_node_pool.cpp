@@ -0,0 +1,71 @@
+#include "catch.hpp"
+#include <gem/node_pool.h>
+#include <list>
+#include <set>
+
+TEST_CASE("node_pool__allocate_and_recycle")
+{
+    gem::node_pool<double, 4> pool;
+    std::set<double*> pointers;
+    for (int i = 0; i < 10; ++i)
+    {
+        pointers.insert(pool.allocate(1));
+    }
+    REQUIRE(10 == pointers.size());
+    const auto recycled = *pointers.begin();
+    pool.deallocate(recycled, 1);
+    REQUIRE(recycled == pool.allocate(1));
+    for (const auto p : pointers)
+    {
+        pool.deallocate(p, 1);
+    }
+}
+
+TEST_CASE("node_pool__arrays_use_global_allocator")
+{
+    gem::node_pool<int> pool;
+    const auto array = pool.allocate(3);
+    array[0] = array[1] = array[2] = 42;
+    pool.deallocate(array, 3);
+}
+
+TEST_CASE("node_pool__rebind_shares_slabs")
+{
+    gem::node_pool<int> pool;
+    gem::node_pool<long> rebound{pool};
+    REQUIRE(pool == rebound);
+    REQUIRE(gem::node_pool<int>{} != pool);
+    REQUIRE_FALSE(pool == std::allocator_traits<gem::node_pool<int>>::
+                               select_on_container_copy_construction(pool));
+}
+
+TEST_CASE("node_pool__with_std_list")
+{
+    std::list<int, gem::node_pool<int, 8>> list;
+    for (int i = 0; i < 100; ++i)
+    {
+        list.push_back(i);
+    }
+    list.remove_if([](const int value) { return value % 2; });
+    REQUIRE(50 == list.size());
+    for (int i = 0; i < 100; ++i)
+    {
+        list.push_front(i);
+    }
+    REQUIRE(150 == list.size());
+}
+
+TEST_CASE("node_pool__reserve_and_release")
+{
+    gem::node_pool<int, 2> pool;
+    pool.allocate(1);
+    pool.reserve(100);
+    std::set<int*> pointers;
+    for (int i = 0; i < 100; ++i)
+    {
+        pointers.insert(pool.allocate(1));
+    }
+    REQUIRE(100 == pointers.size());
+    pool.release();
+    REQUIRE(pool.allocate(1));
+}
@@ -0,0 +1,211 @@
+#include "catch.hpp"
+#include <gem/persistent_hashmap.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct colliding_hash
+{
+    std::size_t
+    operator()(const std::string_view key) const
+    {
+        return key.size();
+    }
+};
+
+} // namespace
+
+TEST_CASE("persistent_hashmap__put_get_remove")
+{
+    gem::persistent_hashmap<int> map;
+    REQUIRE(0 == map.size());
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE_FALSE(map.remove("foo"));
+    REQUIRE_FALSE(map.put("foo", 42));
+    REQUIRE(42 == *map.get("foo"));
+    REQUIRE(42 == *map.put("foo", 43));
+    REQUIRE(43 == *map.get("foo"));
+    REQUIRE_FALSE(map.put("bar", 44));
+    REQUIRE(2 == map.size());
+    REQUIRE(43 == *map.remove("foo"));
+    REQUIRE_FALSE(map.remove("foo"));
+    REQUIRE_FALSE(map.get("foo"));
+    REQUIRE(44 == *map.get("bar"));
+    REQUIRE(1 == map.size());
+}
+
+TEST_CASE("persistent_hashmap__many")
+{
+    gem::persistent_hashmap<int> map;
+    for (int i = 0; i < 10000; ++i)
+    {
+        REQUIRE_FALSE(map.put(std::to_string(i), i));
+    }
+    REQUIRE(10000 == map.size());
+    std::map<std::string, int> entries;
+    map.for_each([&entries](const std::string& key, const int value) {
+        entries.emplace(key, value);
+    });
+    REQUIRE(10000 == entries.size());
+    for (int i = 0; i < 10000; i += 2)
+    {
+        REQUIRE(i == *map.remove(std::to_string(i)));
+    }
+    REQUIRE(5000 == map.size());
+    for (int i = 0; i < 10000; ++i)
+    {
+        REQUIRE(static_cast<bool>(map.get(std::to_string(i))) == (i % 2 == 1));
+    }
+}
+
+TEST_CASE("persistent_hashmap__snapshot")
+{
+    gem::persistent_hashmap<int> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(std::to_string(i), i);
+    }
+    const auto snapshot = map.snapshot();
+    for (int i = 0; i < 1000; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            map.remove(std::to_string(i));
+        }
+        else
+        {
+            map.put(std::to_string(i), -i);
+        }
+    }
+    map.put("new", 42);
+    REQUIRE(1000 == snapshot.size());
+    REQUIRE_FALSE(snapshot.get("new"));
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE(i == *snapshot.get(std::to_string(i)));
+        if (i % 3 == 0)
+        {
+            REQUIRE_FALSE(map.get(std::to_string(i)));
+        }
+        else
+        {
+            REQUIRE(-i == *map.get(std::to_string(i)));
+        }
+    }
+}
+
+TEST_CASE("persistent_hashmap__snapshot_readers")
+{
+    gem::persistent_hashmap<int> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(std::to_string(i), 0);
+    }
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> readers;
+    for (int round = 1; round <= 4; ++round)
+    {
+        readers.emplace_back([snapshot = map.snapshot(), round, &mismatches] {
+            for (int i = 0; i < 1000; ++i)
+            {
+                if (round - 1 != *snapshot.get(std::to_string(i)))
+                {
+                    mismatches++;
+                }
+            }
+        });
+        for (int i = 0; i < 1000; ++i)
+        {
+            map.put(std::to_string(i), round);
+        }
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    REQUIRE(0 == mismatches);
+}
+
+TEST_CASE("persistent_hashmap__snapshot_modified_first")
+{
+    gem::persistent_hashmap<int> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(std::to_string(i), i);
+    }
+    auto snapshot = map.snapshot();
+    // the snapshot copies the root, the rest of the trie stays shared
+    snapshot.put("new", 42);
+    for (int i = 0; i < 1000; ++i)
+    {
+        map.put(std::to_string(i), -i);
+    }
+    REQUIRE(1001 == snapshot.size());
+    REQUIRE_FALSE(map.get("new"));
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE(i == *snapshot.get(std::to_string(i)));
+        REQUIRE(-i == *map.get(std::to_string(i)));
+    }
+}
+
+TEST_CASE("persistent_hashmap__concurrent_snapshots")
+{
+    gem::persistent_hashmap<int> source;
+    for (int i = 0; i < 1000; ++i)
+    {
+        source.put(std::to_string(i), i);
+    }
+    const auto& map = source;
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t)
+    {
+        workers.emplace_back([&map, &mismatches, t] {
+            for (int round = 0; round < 20; ++round)
+            {
+                auto snapshot = map.snapshot();
+                for (int i = t; i < 1000; i += 4)
+                {
+                    if (i != *snapshot.get(std::to_string(i)))
+                    {
+                        mismatches++;
+                    }
+                    snapshot.put(std::to_string(i), -i);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    REQUIRE(0 == mismatches);
+    for (int i = 0; i < 1000; ++i)
+    {
+        REQUIRE(i == *map.get(std::to_string(i)));
+    }
+}
+
+TEST_CASE("persistent_hashmap__collisions")
+{
+    gem::persistent_hashmap<int, colliding_hash> map;
+    map.put("a", 1);
+    map.put("b", 2);
+    map.put("cc", 3);
+    const auto snapshot = map.snapshot();
+    REQUIRE(1 == *map.put("a", 4));
+    REQUIRE(2 == *map.remove("b"));
+    REQUIRE_FALSE(map.get("b"));
+    REQUIRE(4 == *map.get("a"));
+    REQUIRE(3 == *map.get("cc"));
+    REQUIRE(2 == map.size());
+    REQUIRE(1 == *snapshot.get("a"));
+    REQUIRE(2 == *snapshot.get("b"));
+    REQUIRE(3 == snapshot.size());
+}
@@ -0,0 +1,72 @@
+#include "catch.hpp"
+#include <gem/spsc_circular_buffer.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+TEST_CASE("spsc_circular_buffer__push_and_pop")
+{
+    gem::spsc_circular_buffer<std::string, 3> buffer;
+    static_assert(3 == buffer.capacity(), "");
+    REQUIRE(buffer.empty());
+    std::string value;
+    REQUIRE_FALSE(buffer.try_pop(value));
+    REQUIRE(buffer.try_push(std::string{"a"}));
+    REQUIRE(buffer.try_push(std::string{"b"}));
+    REQUIRE(buffer.try_emplace(1, 'c'));
+    REQUIRE(3 == buffer.size());
+    REQUIRE_FALSE(buffer.try_push(std::string{"d"}));
+    REQUIRE(buffer.try_pop(value));
+    REQUIRE("a" == value);
+    REQUIRE(buffer.try_push(std::string{"d"}));
+    for (const auto expected : {"b", "c", "d"})
+    {
+        REQUIRE(buffer.try_pop(value));
+        REQUIRE(expected == value);
+    }
+    REQUIRE(buffer.empty());
+    REQUIRE(0 == buffer.size());
+    REQUIRE_FALSE(buffer.try_pop(value));
+}
+
+TEST_CASE("spsc_circular_buffer__destroys_remaining_values")
+{
+    auto value = std::make_shared<int>(42);
+    {
+        gem::spsc_circular_buffer<std::shared_ptr<int>, 4> buffer;
+        REQUIRE(buffer.try_push(value));
+        REQUIRE(buffer.try_push(value));
+        REQUIRE(3 == value.use_count());
+    }
+    REQUIRE(1 == value.use_count());
+}
+
+TEST_CASE("spsc_circular_buffer__producer_and_consumer")
+{
+    constexpr int count = 100000;
+    gem::spsc_circular_buffer<std::unique_ptr<int>, 64> buffer;
+    std::thread producer{[&buffer] {
+        for (int i = 0; i < count; ++i)
+        {
+            auto value = std::make_unique<int>(i);
+            while (!buffer.try_push(std::move(value)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }};
+    int mismatches = 0;
+    std::unique_ptr<int> value;
+    for (int i = 0; i < count; ++i)
+    {
+        while (!buffer.try_pop(value))
+        {
+            std::this_thread::yield();
+        }
+        mismatches += *value != i;
+    }
+    producer.join();
+    REQUIRE(0 == mismatches);
+    REQUIRE(buffer.empty());
+}
@@ -0,0 +1,131 @@
+#include "catch.hpp"
+#include <gem/timer_wheel.h>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+TEST_CASE("timer_wheel__advance")
+{
+    gem::timer_wheel<int> wheel;
+    wheel.schedule(10, 1);
+    wheel.schedule(5, 2);
+    wheel.schedule(100000, 3);
+    wheel.schedule(64, 4);
+    REQUIRE(4 == wheel.size());
+    std::vector<int> expired;
+    const auto collect = [&expired](const int value) {
+        expired.push_back(value);
+    };
+    REQUIRE(0 == wheel.advance(4, collect));
+    REQUIRE(4 == wheel.now());
+    REQUIRE(2 == wheel.advance(63, collect));
+    REQUIRE(std::vector<int>{2, 1} == expired);
+    REQUIRE(1 == wheel.advance(99999, collect));
+    REQUIRE(std::vector<int>{2, 1, 4} == expired);
+    REQUIRE(1 == wheel.advance(100000, collect));
+    REQUIRE(std::vector<int>{2, 1, 4, 3} == expired);
+    REQUIRE(0 == wheel.size());
+    REQUIRE(100000 == wheel.now());
+}
+
+TEST_CASE("timer_wheel__past_deadline")
+{
+    gem::timer_wheel<int> wheel{1000};
+    const auto h = wheel.schedule(10, 1);
+    REQUIRE(1000 == wheel.deadline(h));
+    int expired = 0;
+    REQUIRE(1 == wheel.advance(1000, [&expired](const int) { expired++; }));
+    REQUIRE(1 == expired);
+}
+
+TEST_CASE("timer_wheel__cancel")
+{
+    gem::timer_wheel<int> wheel;
+    wheel.schedule(10, 1);
+    const auto h2 = wheel.schedule(10, 2);
+    const auto h3 = wheel.schedule(5000, 3);
+    REQUIRE(2 == wheel.cancel(h2));
+    REQUIRE(3 == wheel.cancel(h3));
+    REQUIRE(1 == wheel.size());
+    std::vector<int> expired;
+    wheel.advance(10000, [&expired](const int value) {
+        expired.push_back(value);
+    });
+    REQUIRE(std::vector<int>{1} == expired);
+    REQUIRE(0 == wheel.size());
+}
+
+TEST_CASE("timer_wheel__random_deadlines_expire_in_order")
+{
+    gem::timer_wheel<std::uint64_t> wheel;
+    std::mt19937_64 random{42};
+    std::vector<gem::timer_wheel<std::uint64_t>::handle> handles;
+    for (int i = 0; i < 10000; ++i)
+    {
+        const auto deadline = random() >> (random() % 64);
+        handles.push_back(wheel.schedule(deadline, deadline));
+    }
+    for (std::size_t i = 0; i < handles.size(); i += 3)
+    {
+        wheel.cancel(handles[i]);
+    }
+    const auto pending = wheel.size();
+    std::uint64_t now = 0;
+    std::uint64_t last = 0;
+    std::size_t expired = 0;
+    while (wheel.size())
+    {
+        now = now * 3 + random() % 1000;
+        wheel.advance(now, [&](const std::uint64_t deadline) {
+            REQUIRE(deadline <= now);
+            REQUIRE(deadline >= last);
+            last = deadline;
+            expired++;
+        });
+    }
+    REQUIRE(pending == expired);
+}
+
+TEST_CASE("timer_wheel__schedule_while_advancing")
+{
+    gem::timer_wheel<int> wheel;
+    wheel.schedule(10, 0);
+    std::vector<int> expired;
+    wheel.advance(100, [&](const int value) {
+        expired.push_back(value);
+        if (value < 3)
+        {
+            wheel.schedule(wheel.now() + 20, value + 1);
+        }
+    });
+    REQUIRE(std::vector<int>{0, 1, 2, 3} == expired);
+    REQUIRE(100 == wheel.now());
+}
+
+TEST_CASE("timer_wheel__copy_and_move")
+{
+    gem::timer_wheel<int> wheel;
+    for (int i = 0; i < 5; ++i)
+    {
+        wheel.schedule(static_cast<std::uint64_t>(10 + i), i);
+    }
+    const auto copy = wheel;
+    REQUIRE(5 == copy.size());
+    auto moved = std::move(wheel);
+    REQUIRE(5 == moved.size());
+    // the moved-from wheel is empty and usable
+    REQUIRE(0 == wheel.size());
+    wheel.schedule(3, 42);
+    std::vector<int> expired;
+    const auto collect = [&expired](const int value) {
+        expired.push_back(value);
+    };
+    REQUIRE(1 == wheel.advance(100, collect));
+    REQUIRE(std::vector<int>{42} == expired);
+    REQUIRE(5 == moved.advance(100, collect));
+    REQUIRE(6 == expired.size());
+    moved = std::move(wheel);
+    REQUIRE(0 == moved.size());
+    REQUIRE(100 == moved.now());
+}